@@ -0,0 +1,356 @@
+/*!
+ * \file honokamiku_benchmark.c
+ * Benchmark executable, built with HONOKAMIKU_BUILD_BENCHMARK
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "honokamiku_decrypter.h"
+#include "md5.h"
+
+/*!
+ * Initialize decrypter context of a JP game file with `decrypt_mode`.
+ */
+static int bench_context(honokamiku_context *dctx, honokamiku_decrypt_mode decrypt_mode)
+{
+	unsigned char header[16];
+
+	return honokamiku_encrypt_init(
+		dctx,
+		decrypt_mode,
+		honokamiku_gamefile_jp,
+		NULL,
+		NULL,
+		-1,
+		"benchmark/file.png",
+		header,
+		sizeof(header)
+	);
+}
+
+static double bench_seconds(clock_t start)
+{
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*!
+ * Seek latency against file size: seek back and forth between the start
+ * and the offset.
+ */
+static void bench_seek()
+{
+	static const unsigned int offsets[] = {
+		4096U, 1048576U, 16777216U, 209715200U, 4294967295U
+	};
+	static const honokamiku_decrypt_mode modes[] = {
+		honokamiku_decrypt_version3,
+		honokamiku_decrypt_version6
+	};
+	const long seeks = 1000000;
+	size_t i, j;
+
+	puts("seek: offset      V3 ns/seek  V6 ns/seek");
+
+	for (i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+	{
+		printf("seek: %10u", offsets[i]);
+
+		for (j = 0; j < sizeof(modes) / sizeof(modes[0]); j++)
+		{
+			honokamiku_context dctx;
+			clock_t start;
+			long k;
+
+			bench_context(&dctx, modes[j]);
+			start = clock();
+
+			for (k = 0; k < seeks; k += 2)
+			{
+				honokamiku_jump_offset(&dctx, offsets[i]);
+				honokamiku_jump_offset(&dctx, (unsigned int) k & 4095);
+			}
+
+			printf("  %10.1f", bench_seconds(start) * 1e9 / seeks);
+		}
+
+		putchar('\n');
+	}
+}
+
+/*!
+ * Decryption throughput of version 6 against version 3, in-place on a 16MB
+ * buffer.
+ */
+static void bench_throughput()
+{
+	static const honokamiku_decrypt_mode modes[] = {
+		honokamiku_decrypt_version3,
+		honokamiku_decrypt_version6
+	};
+	const size_t size = 16777216;
+	const int passes = 16;
+	unsigned char *buffer = (unsigned char *) calloc(1, size);
+	size_t i;
+
+	if (buffer == NULL)
+	{
+		fputs("throughput: Not enough memory\n", stderr);
+		return;
+	}
+
+	puts("throughput: mode  MB/s");
+
+	for (i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+	{
+		honokamiku_context dctx;
+		clock_t start;
+		double seconds;
+		int k;
+
+		bench_context(&dctx, modes[i]);
+		start = clock();
+
+		for (k = 0; k < passes; k++)
+			honokamiku_decrypt_block(&dctx, buffer, size);
+
+		seconds = bench_seconds(start);
+		printf("throughput: V%d  %8.0f\n", (int) modes[i], (double) size * passes / seconds / 1e6);
+	}
+
+	free(buffer);
+}
+
+/*!
+ * MD5 throughput: short messages like the ones hashed to initialize
+ * decrypter contexts, and one long message.
+ */
+static void bench_md5()
+{
+	static const unsigned int sizes[] = {40, 100, 200};
+	const size_t size = 16777216;
+	const long messages = 2000000;
+	unsigned char *buffer = (unsigned char *) calloc(1, size);
+	MD5_CTX mctx;
+	clock_t start;
+	size_t i;
+
+	if (buffer == NULL)
+	{
+		fputs("md5: Not enough memory\n", stderr);
+		return;
+	}
+
+	puts("md5: message   speed");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		long k;
+
+		start = clock();
+
+		for (k = 0; k < messages; k++)
+		{
+			MD5Init(&mctx);
+			MD5Update(&mctx, buffer + (k & 63), sizes[i]);
+			MD5Final(&mctx);
+			buffer[k & 63] = mctx.digest[0];
+		}
+
+		printf("md5: %4u B   %6.2f M/s\n", sizes[i], messages / bench_seconds(start) / 1e6);
+	}
+
+	start = clock();
+	MD5Init(&mctx);
+	for (i = 0; i < 8; i++)
+		MD5Update(&mctx, buffer, (unsigned int) size);
+	MD5Final(&mctx);
+	printf("md5: %4u MB  %6.1f MB/s\n", (unsigned int) (size >> 20), size * 8.0 / bench_seconds(start) / 1e6);
+
+	free(buffer);
+}
+
+/*!
+ * Scatter/gather decryption of fragments, one honokamiku_decrypt_block()
+ * per fragment against one honokamiku_decrypt_vector().
+ */
+static void bench_vector()
+{
+	static const size_t sizes[] = {64, 256, 1460, 4096};
+	const size_t count = 4096;
+	const size_t total = 67108864; /* Bytes decrypted per size */
+	honokamiku_iovec *segments = (honokamiku_iovec *) malloc(count * sizeof(honokamiku_iovec));
+	unsigned char *buffer = (unsigned char *) calloc(count, 4096);
+	size_t i, j;
+
+	if (segments == NULL || buffer == NULL)
+	{
+		fputs("vector: Not enough memory\n", stderr);
+		free(segments);
+		free(buffer);
+		return;
+	}
+
+	puts("vector: fragment  block MB/s  vector MB/s");
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		honokamiku_context dctx;
+		double speed[2];
+		int k;
+
+		for (j = 0; j < count; j++)
+		{
+			segments[j].buffer = buffer + j * sizes[i];
+			segments[j].buffer_size = sizes[i];
+		}
+
+		bench_context(&dctx, honokamiku_decrypt_version3);
+
+		for (k = 0; k < 2; k++)
+		{
+			clock_t start = clock();
+			size_t done;
+
+			for (done = 0; done < total; done += count * sizes[i])
+			{
+				if (k)
+					honokamiku_decrypt_vector(&dctx, segments, count);
+				else
+					for (j = 0; j < count; j++)
+						honokamiku_decrypt_block(&dctx, segments[j].buffer, segments[j].buffer_size);
+			}
+
+			speed[k] = total / bench_seconds(start) / 1e6;
+		}
+
+		printf("vector: %6u B  %10.0f  %11.0f\n", (unsigned int) sizes[i], speed[0], speed[1]);
+	}
+
+	free(segments);
+	free(buffer);
+}
+
+/*!
+ * Decryption of many version 3, 4 and 6 files of mixed sizes between 64B
+ * and 4KB, one honokamiku_decrypt_block() per file against one
+ * honokamiku_decrypt_many().
+ */
+static void bench_many()
+{
+	static const honokamiku_decrypt_mode modes[] = {
+		honokamiku_decrypt_version3,
+		honokamiku_decrypt_version4,
+		honokamiku_decrypt_version6
+	};
+	const size_t count = 4096;
+	const size_t total = 268435456; /* Bytes decrypted per function */
+	honokamiku_context *contexts = (honokamiku_context *) malloc(count * sizeof(honokamiku_context));
+	honokamiku_context *pass_contexts = (honokamiku_context *) malloc(count * sizeof(honokamiku_context));
+	honokamiku_iovec *files = (honokamiku_iovec *) malloc(count * sizeof(honokamiku_iovec));
+	unsigned char *buffer = (unsigned char *) calloc(count, 4096);
+	size_t size = 0, i;
+	double speed[2];
+	int k;
+
+	if (contexts == NULL || pass_contexts == NULL || files == NULL || buffer == NULL)
+	{
+		fputs("many: Not enough memory\n", stderr);
+		free(contexts);
+		free(pass_contexts);
+		free(files);
+		free(buffer);
+		return;
+	}
+
+	srand(1);
+
+	for (i = 0; i < count; i++)
+	{
+		bench_context(&contexts[i], modes[i % 3]);
+		files[i].buffer = buffer + size;
+		files[i].buffer_size = 64 + (size_t) rand() % 4033;
+		size += files[i].buffer_size;
+	}
+
+	puts("many: files        block MB/s  many MB/s");
+
+	for (k = 0; k < 2; k++)
+	{
+		clock_t start = clock();
+		size_t done;
+
+		for (done = 0; done < total; done += size)
+		{
+			memcpy(pass_contexts, contexts, count * sizeof(honokamiku_context));
+
+			if (k)
+				honokamiku_decrypt_many(pass_contexts, files, count);
+			else
+				for (i = 0; i < count; i++)
+					honokamiku_decrypt_block(&pass_contexts[i], files[i].buffer, files[i].buffer_size);
+		}
+
+		speed[k] = (double) done / bench_seconds(start) / 1e6;
+	}
+
+	printf("many: 64B-4KB  %10.0f  %9.0f\n", speed[0], speed[1]);
+
+	free(contexts);
+	free(pass_contexts);
+	free(files);
+	free(buffer);
+}
+
+typedef struct bench_case
+{
+	const char *name;
+	void (*run)();
+} bench_case;
+
+static const bench_case bench_cases[] = {
+	{"seek", bench_seek},
+	{"throughput", bench_throughput},
+	{"md5", bench_md5},
+	{"vector", bench_vector},
+	{"many", bench_many}
+};
+
+int main(int argc, char *argv[])
+{
+	size_t count = sizeof(bench_cases) / sizeof(bench_cases[0]), i;
+
+	for (i = 1; i < (size_t) argc; i++)
+	{
+		size_t j;
+
+		for (j = 0; j < count && strcmp(argv[i], bench_cases[j].name) != 0; j++);
+
+		if (j == count)
+		{
+			fprintf(stderr, "Usage: %s [benchmark...]\nBenchmarks:", argv[0]);
+			for (j = 0; j < count; j++)
+				fprintf(stderr, " %s", bench_cases[j].name);
+			fputs("\nRuns all of them if none specified. Set HONOKAMIKU_KERNEL to\n"
+			      "benchmark other kernels.\n", stderr);
+			return 1;
+		}
+	}
+
+	printf("kernels: %s\n", honokamiku_kernel_name());
+
+	for (i = 0; i < count; i++)
+	{
+		int j, run = argc == 1;
+
+		for (j = 1; j < argc; j++)
+			run |= strcmp(argv[j], bench_cases[i].name) == 0;
+
+		if (run)
+			bench_cases[i].run();
+	}
+
+	return 0;
+}
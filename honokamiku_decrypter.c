@@ -9,6 +9,7 @@
 #define HONOKAMIKU_DECRYPTER_CORE
 
 #include "honokamiku_decrypter.h"
+#include "honokamiku_internal.h"
 #include "honokamiku_key_tables.h"
 #include "honokamiku_config.h"
 #include "md5.h"
@@ -37,6 +38,193 @@ const char *libhonoka__basename(const char *name)
 	else return name;
 }
 
+/*!
+ * Advance LCG key by `steps` at once, in O(log steps). Used internally
+ */
+static unsigned int libhonoka__lcg_jump(
+	unsigned int key,
+	unsigned int mul_val,
+	unsigned int add_val,
+	unsigned int steps
+)
+{
+	size_t i;
+
+	/* Known LCG parameters have precomputed 2^i step tables */
+	for (i = 0; i < 4; i++)
+	{
+		if (
+			lcg_key_tables[i].multipler == mul_val &&
+			lcg_key_tables[i].increment == add_val
+		)
+		{
+			const lcg_jump *jump = lcg_jump_tables[i];
+
+			/* Without branch on the bits, which are random for sizes */
+			for (; steps; jump++, steps >>= 1)
+			{
+				unsigned int take = 0U - (steps & 1);
+				key = ((jump->multipler * key + jump->increment) & take) | (key & ~take);
+			}
+
+			return key;
+		}
+	}
+
+	/* Otherwise, square-and-multiply the (mul, add) pair */
+	for (; steps; steps >>= 1)
+	{
+		if (steps & 1)
+			key = mul_val * key + add_val;
+
+		add_val = (mul_val + 1) * add_val;
+		mul_val *= mul_val;
+	}
+
+	return key;
+}
+
+void libhonoka__lcg_lanes(
+	unsigned int          key,
+	const libhonoka__lcg *lcg,
+	unsigned int         *lanes,
+	size_t                count,
+	unsigned int         *mul_val,
+	unsigned int         *add_val
+)
+{
+	size_t i;
+
+	*mul_val = 1;
+	*add_val = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		lanes[i] = key;
+		key = lcg->mul_val * key + lcg->add_val;
+		*mul_val *= lcg->mul_val;
+		*add_val = lcg->mul_val * *add_val + lcg->add_val;
+	}
+}
+
+/*!
+ * Copy primary (or secondary) LCG parameters of decrypter context, to be
+ * passed to the kernels. Used internally
+ */
+static void libhonoka__get_lcg(
+	const honokamiku_context *dctx,
+	libhonoka__lcg           *lcg,
+	int                       second
+)
+{
+	if (second)
+	{
+		lcg->mul_val = dctx->second_mul_val;
+		lcg->add_val = dctx->second_add_val;
+		lcg->shift_val = dctx->second_shift_val;
+	}
+	else
+	{
+		lcg->mul_val = dctx->mul_val;
+		lcg->add_val = dctx->add_val;
+		lcg->shift_val = dctx->shift_val;
+	}
+}
+
+/*!
+ * Reduce value modulo 2^31 - 1. Used internally
+ */
+static unsigned int libhonoka__mod31(unsigned int val)
+{
+	val = (val & 2147483647) + (val >> 31);
+	return val >= 2147483647 ? val - 2147483647 : val;
+}
+
+/*!
+ * Multiply 2 values modulo 2^31 - 1 without 64-bit integer. Both values
+ * must be less than 2^31 - 1. Used internally
+ */
+static unsigned int libhonoka__mulmod31(unsigned int a, unsigned int b)
+{
+	unsigned int ah = a >> 16, al = a & 65535;
+	unsigned int bh = b >> 16, bl = b & 65535;
+	unsigned int mid = ah * bl + al * bh;
+	unsigned int r;
+
+	/* 2^32 = 2 and 2^31 = 1 in modulo 2^31 - 1 */
+	r = libhonoka__mod31((ah * bh) << 1);
+	r = libhonoka__mod31(r + ((mid & 32767) << 16));
+	r = libhonoka__mod31(r + (mid >> 15));
+	return libhonoka__mod31(r + libhonoka__mod31(al * bl));
+}
+
+/*!
+ * Set version 2 key to the `steps`-th key after `init_key`. Used internally
+ */
+static void libhonoka__v2_jump(honokamiku_context *dctx, unsigned int steps)
+{
+	const unsigned int *jump = v2_jump_tables;
+	unsigned int key = dctx->init_key;
+	unsigned int back = 0;
+	unsigned int i;
+
+	if (key == 0 || key == 2147483647)
+	{
+		/* Those stays forever */
+		dctx->update_key = key;
+		dctx->xor_key = ((key >> 23) & 255) | ((key >> 7) & 65280);
+		return;
+	}
+
+	/* update_key = init_key * 16807^steps mod (2^31 - 1) */
+	for (i = steps; i; jump++, i >>= 1)
+		if (i & 1)
+			key = libhonoka__mulmod31(key, *jump);
+
+	/* honokamiku_update_v2 doesn't always fully reduce the key: small keys */
+	/* can end up as key + 2^31 - 1 depending on the previous key. Walk */
+	/* back (1407677000 is the inverse of 16807) until the key is known to */
+	/* be reduced, then redo those steps with honokamiku_update_v2 */
+	for (; key < 33614 && back < steps; back++)
+		key = libhonoka__mulmod31(key, 1407677000);
+
+	dctx->update_key = back == steps ? dctx->init_key : key;
+	dctx->xor_key = ((dctx->update_key >> 23) & 255) |
+	                ((dctx->update_key >> 7) & 65280);
+
+	for (; back; back--)
+		honokamiku_update_v2(dctx);
+}
+
+int libhonoka__v2_lanes(
+	unsigned int  key,
+	unsigned int *lanes,
+	size_t        count,
+	unsigned int *mul_val
+)
+{
+	honokamiku_context tmp;
+	size_t i;
+
+	/* Key before `key`, fully reduced. 1407677000 is the inverse of 16807 */
+	tmp.update_key = libhonoka__mulmod31(libhonoka__mod31(key), 1407677000);
+	lanes[0] = tmp.update_key;
+	honokamiku_update_v2(&tmp);
+
+	if (tmp.update_key != key)
+		return 0;
+
+	for (i = 1; i < count; i++)
+		lanes[i] = libhonoka__mulmod31(lanes[i - 1], 16807);
+
+	*mul_val = 1;
+	for (i = 0; count; i++, count >>= 1)
+		if (count & 1)
+			*mul_val = libhonoka__mulmod31(*mul_val, v2_jump_tables[i]);
+
+	return 1;
+}
+
 const char *honokamiku_version_string()
 {
 	return HONOKAMIKU_VERSION_STRING;
@@ -77,33 +265,21 @@ size_t honokamiku_header_size(honokamiku_decrypt_mode decrypt_mode)
 }
 
 /*!
- * Initialize decrypter context. Used internally
+ * Initialize decrypter context from MD5 of prefix and basename. Used
+ * internally
  */
-int honokamiku_dinit(
-	honokamiku_context		*dctx,
-	honokamiku_decrypt_mode	 decrypt_mode,
-	const char				*prefix,
-	const char				*filename,
-	const void				*file_header
+static int libhonoka__dinit_digest(
+	honokamiku_context      *dctx,
+	honokamiku_decrypt_mode  decrypt_mode,
+	const char              *prefix,
+	size_t                   filename_size,
+	const unsigned char     *digest,
+	const void              *file_header
 )
 {
-	/* The MD5 context */
-	MD5_CTX mctx;
-	/* Will contain the length of filename. */
-	size_t filename_size;
-
 	/* Zero memory */
 	memset(dctx, 0, sizeof(honokamiku_context));
-	
-	/* Get basename */
-	filename = libhonoka__basename(filename);
-	filename_size = strlen(filename);
-	
-	MD5Init(&mctx);
-	MD5Update(&mctx, (unsigned char*)prefix, strlen(prefix));
-	MD5Update(&mctx, (unsigned char*)filename, filename_size);
-	MD5Final(&mctx);
-	
+
 	if (decrypt_mode == honokamiku_decrypt_none)
 		/* Do nothing */
 		return HONOKAMIKU_ERR_OK;
@@ -111,10 +287,10 @@ int honokamiku_dinit(
 	{
 		dctx->update_key = filename_size + 1;
 		dctx->xor_key = dctx->init_key =
-			(mctx.digest[0] << 24) |
-			(mctx.digest[1] << 16) |
-			(mctx.digest[2] << 8) |
-			(mctx.digest[3]);
+			(digest[0] << 24) |
+			(digest[1] << 16) |
+			(digest[2] << 8) |
+			(digest[3]);
 		dctx->pos = 0;
 		dctx->dm = honokamiku_decrypt_version1;
 		return HONOKAMIKU_ERR_OK;
@@ -124,14 +300,14 @@ int honokamiku_dinit(
        )
 	{
 		/* Check if we can decrypt this */
-		if (memcmp(mctx.digest + 4, file_header, 4) == 0)
+		if (memcmp(digest + 4, file_header, 4) == 0)
 		{
 			/* Initialize decrypter context */
 			dctx->dm = honokamiku_decrypt_version2;
-			dctx->init_key = ((mctx.digest[0] & 127) << 24) |
-										  (mctx.digest[1] << 16) |
-										  (mctx.digest[2] << 8) |
-										  mctx.digest[3];
+			dctx->init_key = ((digest[0] & 127) << 24) |
+										  (digest[1] << 16) |
+										  (digest[2] << 8) |
+										  digest[3];
 			dctx->xor_key = ((dctx->init_key >> 23) & 255) |
 										 ((dctx->init_key >> 7) & 65280);
 			dctx->update_key = dctx->init_key;
@@ -152,9 +328,9 @@ int honokamiku_dinit(
 		char actual_file_header[3];
 		
 		/* Flip file header bytes */
-		actual_file_header[0] = ~mctx.digest[4];
-		actual_file_header[1] = ~mctx.digest[5];
-		actual_file_header[2] = ~mctx.digest[6];
+		actual_file_header[0] = ~digest[4];
+		actual_file_header[1] = ~digest[5];
+		actual_file_header[2] = ~digest[6];
 		
 		if (memcmp(actual_file_header, file_header, 3) == 0)
 		{
@@ -164,15 +340,15 @@ int honokamiku_dinit(
 			dctx->dm = decrypt_mode;
 			dctx->pos = 0;
 			dctx->v3_initialized = 0;
-			dctx->init_key = ((mctx.digest[8] << 24) |
-				(mctx.digest[9] << 16) |
-				(mctx.digest[10] << 8) |
-				mctx.digest[11]
+			dctx->init_key = ((digest[8] << 24) |
+				(digest[9] << 16) |
+				(digest[10] << 8) |
+				digest[11]
 			);
-			dctx->second_init_key = ((mctx.digest[12] << 24) |
-				(mctx.digest[13] << 16) |
-				(mctx.digest[14] << 8) |
-				mctx.digest[15]
+			dctx->second_init_key = ((digest[12] << 24) |
+				(digest[13] << 16) |
+				(digest[14] << 8) |
+				digest[15]
 			);
 
 			/* Calculate automatic name sum */
@@ -190,6 +366,34 @@ int honokamiku_dinit(
 	return HONOKAMIKU_ERR_DECRYPTUNKNOWN;
 }
 
+/*!
+ * Initialize decrypter context. Used internally
+ */
+int honokamiku_dinit(
+	honokamiku_context		*dctx,
+	honokamiku_decrypt_mode	 decrypt_mode,
+	const char				*prefix,
+	const char				*filename,
+	const void				*file_header
+)
+{
+	/* The MD5 context */
+	MD5_CTX mctx;
+	/* Will contain the length of filename. */
+	size_t filename_size;
+
+	/* Get basename */
+	filename = libhonoka__basename(filename);
+	filename_size = strlen(filename);
+	
+	MD5Init(&mctx);
+	MD5Update(&mctx, (unsigned char*)prefix, strlen(prefix));
+	MD5Update(&mctx, (unsigned char*)filename, filename_size);
+	MD5Final(&mctx);
+
+	return libhonoka__dinit_digest(dctx, decrypt_mode, prefix, filename_size, mctx.digest, file_header);
+}
+
 /*!
  * Initialize decrypter context for encryption. Used internally
  */
@@ -367,6 +571,7 @@ int honokamiku_einit(
 				dctx->init_key = ~dctx->init_key;
 
 				dctx->v5_encrypt = decrypt_mode == honokamiku_decrypt_version5;
+				dctx->v5_chain = 89;
 
 				break;
 			}
@@ -387,72 +592,73 @@ int honokamiku_einit(
 	return HONOKAMIKU_ERR_INVALIDMETHOD;
 }
 
-void honokamiku_decrypt_block(
+/*!
+ * XOR `size` bytes of `src` with the keystream into `dst`, which may be the
+ * same buffer. Used internally
+ */
+static void libhonoka__decrypt(
 	honokamiku_context  *dctx,
-	void                *buffer,
+	const char          *src,
+	char                *dst,
 	size_t               buffer_size
 )
 {
-	char* file_buffer = (char*)buffer;
+	const libhonoka__kernels *kernels = libhonoka__get_kernels();
 	
 	if (buffer_size == 0) return; /* Do nothing */
 	switch(dctx->dm)
 	{
-		case honokamiku_decrypt_none: return;
+		case honokamiku_decrypt_none:
+		{
+			if (src != dst)
+				memcpy(dst, src, buffer_size);
+
+			return;
+		}
 		case honokamiku_decrypt_version1:
 		{
 			unsigned int last_pos = dctx->pos & 3;
-			size_t decrypt_size;
+			size_t decrypt_size = buffer_size;
 
-			if(last_pos == 1)
+			/* Finish the current key first. Each key covers 4 bytes, */
+			/* most significant byte first */
+			for (; last_pos != 0 && decrypt_size != 0; decrypt_size--)
 			{
-				*file_buffer++ ^= dctx->xor_key >> 16;
-				buffer_size--;
+				*dst++ = *src++ ^ (dctx->xor_key >> (24 - last_pos * 8));
+				last_pos = (last_pos + 1) & 3;
 
-				if(buffer_size > 0)
-					goto first_last_pos_mod2;
+				if (last_pos == 0)
+					dctx->xor_key += dctx->update_key;
 			}
-			else if(last_pos == 2)
-			{
-				first_last_pos_mod2:
 
-				*file_buffer++ ^= dctx->xor_key >> 8;
-				buffer_size--;
-
-				if(buffer_size > 0)
-					goto first_last_pos_mod3;
-			}
-			else if(last_pos == 3)
+			if (kernels->v1_xor && decrypt_size >= LIBHONOKA_KERNEL_MIN)
 			{
-				first_last_pos_mod3:
-
-				*file_buffer++ ^= dctx->xor_key;
-				buffer_size--;
-
-				dctx->xor_key += dctx->update_key;
+				/* Do the bulk in multi-lane kernel */
+				size_t done = kernels->v1_xor(
+					&dctx->xor_key,
+					dctx->update_key,
+					(const unsigned char *) src,
+					(unsigned char *) dst,
+					decrypt_size
+				);
+				src += done;
+				dst += done;
+				decrypt_size -= done;
 			}
 
-			for (decrypt_size = buffer_size >> 2; decrypt_size != 0; decrypt_size--, file_buffer += 4)
+			for (; decrypt_size >= 4; decrypt_size -= 4, src += 4, dst += 4)
 			{
-				file_buffer[0] ^= dctx->xor_key >> 24;
-				file_buffer[1] ^= dctx->xor_key >> 16;
-				file_buffer[2] ^= dctx->xor_key >> 8;
-				file_buffer[3] ^= dctx->xor_key;
+				dst[0] = src[0] ^ (dctx->xor_key >> 24);
+				dst[1] = src[1] ^ (dctx->xor_key >> 16);
+				dst[2] = src[2] ^ (dctx->xor_key >> 8);
+				dst[3] = src[3] ^ dctx->xor_key;
 
 				dctx->xor_key += dctx->update_key;
 			}
 
-			if ((buffer_size & 0xFFFFFFFCU) != buffer_size)
-			{
-				last_pos = buffer_size & 3;
-			
-				if(last_pos >= 1)
-					file_buffer[0] ^= dctx->xor_key >> 24;
-				if(last_pos >= 2)
-					file_buffer[1] ^= dctx->xor_key >> 16;
-				if(last_pos >= 3)
-					file_buffer[2] ^= dctx->xor_key >> 8;
-			}
+			/* Remaining bytes use the current key, which isn't updated */
+			for (last_pos = 0; last_pos < decrypt_size; last_pos++)
+				dst[last_pos] = src[last_pos] ^ (dctx->xor_key >> (24 - last_pos * 8));
 
 			break;
 		}
@@ -464,21 +670,37 @@ void honokamiku_decrypt_block(
 			if (dctx->pos & 1)
 			{
 				/* Then we'll decrypt single byte and update the key */
-				file_buffer[0] ^= dctx->xor_key >> 8;
-				file_buffer++;
+				*dst++ = *src++ ^ (dctx->xor_key >> 8);
 				dctx->pos++;
 				buffer_size--;
 				
 				honokamiku_update_v2(dctx);
 			}
+
+			if (kernels->v2_xor && buffer_size >= LIBHONOKA_KERNEL_MIN)
+			{
+				/* Do the bulk in multi-lane kernel */
+				size_t done = kernels->v2_xor(
+					&dctx->update_key,
+					(const unsigned char *) src,
+					(unsigned char *) dst,
+					buffer_size
+				);
+				dctx->xor_key = ((dctx->update_key >> 23) & 255) |
+				                ((dctx->update_key >> 7) & 65280);
+				src += done;
+				dst += done;
+				dctx->pos += done;
+				buffer_size -= done;
+			}
 			
 			/* Because we'll decrypt 2 bytes in every loop, divide by 2 */
 			decrypt_size = buffer_size >> 1;
 			
-			for (; decrypt_size!=0; decrypt_size--, file_buffer+=2)
+			for (; decrypt_size!=0; decrypt_size--, src+=2, dst+=2)
 			{
-				file_buffer[0] ^= dctx->xor_key;
-				file_buffer[1] ^= dctx->xor_key >> 8;
+				dst[0] = src[0] ^ dctx->xor_key;
+				dst[1] = src[1] ^ (dctx->xor_key >> 8);
 				
 				honokamiku_update_v2(dctx);
 			}
@@ -486,7 +708,7 @@ void honokamiku_decrypt_block(
 			/* If it's odd, there should be 1 character need to decrypted. */
 			/* In this case, we decrypt the last byte but don't update the key */
 			if ((buffer_size & ((size_t)(-2))) != buffer_size)
-				file_buffer[0] ^= dctx->xor_key;
+				dst[0] = src[0] ^ dctx->xor_key;
 
 			break;
 		}
@@ -496,11 +718,31 @@ void honokamiku_decrypt_block(
 			unsigned int i;
 			size_t decrypt_size = buffer_size;
 
+			if (kernels->lcg_xor && decrypt_size >= LIBHONOKA_KERNEL_MIN)
+			{
+				/* Do the bulk in multi-lane kernel */
+				size_t done;
+				libhonoka__lcg lcg;
+
+				libhonoka__get_lcg(dctx, &lcg, 0);
+				done = kernels->lcg_xor(
+					&dctx->update_key,
+					&lcg,
+					(const unsigned char *) src,
+					(unsigned char *) dst,
+					decrypt_size
+				);
+				dctx->xor_key = dctx->update_key;
+				src += done;
+				dst += done;
+				decrypt_size -= done;
+			}
+
 			for(
 				i = dctx->xor_key;
 				decrypt_size;
 				i = (dctx->update_key = dctx->mul_val * dctx->update_key + dctx->add_val), decrypt_size--)
-				*file_buffer++ ^= (i >> dctx->shift_val);
+				*dst++ = *src++ ^ (i >> dctx->shift_val);
 
 			dctx->xor_key = i;
 			break;
@@ -510,14 +752,36 @@ void honokamiku_decrypt_block(
 			/* AuahDark: I haven't inspected V5 encryption more */
 			/* but caraxian said it works */
 			size_t decrypt_size = buffer_size;
-			char unknown = 89;
+			char unknown = (char)dctx->v5_chain;
 
 			if(dctx->v5_encrypt)
 			{
+				if (kernels->v5_encrypt && decrypt_size >= LIBHONOKA_KERNEL_MIN)
+				{
+					/* Do the bulk in multi-lane kernel */
+					size_t done;
+					libhonoka__lcg lcg;
+
+					libhonoka__get_lcg(dctx, &lcg, 0);
+					done = kernels->v5_encrypt(
+						&dctx->update_key,
+						&lcg,
+						&dctx->v5_chain,
+						(const unsigned char *) src,
+						(unsigned char *) dst,
+						decrypt_size
+					);
+					dctx->xor_key = dctx->update_key;
+					src += done;
+					dst += done;
+					decrypt_size -= done;
+					unknown = (char)dctx->v5_chain;
+				}
+
 				while(decrypt_size--)
 				{
-					unknown ^= (dctx->xor_key >> dctx->shift_val) ^ *file_buffer;
-					*file_buffer++ = unknown;
+					unknown ^= (dctx->xor_key >> dctx->shift_val) ^ *src++;
+					*dst++ = unknown;
 
 					dctx->xor_key = (
 						dctx->update_key =
@@ -529,10 +793,32 @@ void honokamiku_decrypt_block(
 			}
 			else
 			{
+				if (kernels->v5_decrypt && decrypt_size >= LIBHONOKA_KERNEL_MIN)
+				{
+					/* Do the bulk in multi-lane kernel */
+					size_t done;
+					libhonoka__lcg lcg;
+
+					libhonoka__get_lcg(dctx, &lcg, 0);
+					done = kernels->v5_decrypt(
+						&dctx->update_key,
+						&lcg,
+						&dctx->v5_chain,
+						(const unsigned char *) src,
+						(unsigned char *) dst,
+						decrypt_size
+					);
+					dctx->xor_key = dctx->update_key;
+					src += done;
+					dst += done;
+					decrypt_size -= done;
+					unknown = (char)dctx->v5_chain;
+				}
+
 				while(decrypt_size--)
 				{
-					char temp = *file_buffer;
-					*file_buffer++ ^= (dctx->xor_key >> dctx->shift_val) ^ unknown;
+					char temp = *src++;
+					*dst++ = temp ^ (dctx->xor_key >> dctx->shift_val) ^ unknown;
 					unknown = temp;
 
 					dctx->xor_key = (
@@ -543,6 +829,9 @@ void honokamiku_decrypt_block(
 					);
 				}
 			}
+
+			/* Keep the last encrypted byte for the next call */
+			dctx->v5_chain = (unsigned char)unknown;
 			break;
 		}
 		case honokamiku_decrypt_version6:
@@ -550,9 +839,33 @@ void honokamiku_decrypt_block(
 			/* Update 2 LCG at same time :) */
 			size_t decrypt_size = buffer_size;
 
+			if (kernels->lcg2_xor && decrypt_size >= LIBHONOKA_KERNEL_MIN)
+			{
+				/* Do the bulk in multi-lane kernel */
+				size_t done;
+				libhonoka__lcg lcg, lcg2;
+
+				libhonoka__get_lcg(dctx, &lcg, 0);
+				libhonoka__get_lcg(dctx, &lcg2, 1);
+				done = kernels->lcg2_xor(
+					&dctx->update_key,
+					&lcg,
+					&dctx->second_update_key,
+					&lcg2,
+					(const unsigned char *) src,
+					(unsigned char *) dst,
+					decrypt_size
+				);
+				dctx->xor_key = dctx->update_key;
+				dctx->second_xor_key = dctx->second_update_key;
+				src += done;
+				dst += done;
+				decrypt_size -= done;
+			}
+
 			while(decrypt_size--)
 			{
-				*file_buffer++ ^= (
+				*dst++ = *src++ ^ (
 					(dctx->xor_key >> dctx->shift_val) ^
 					(dctx->second_xor_key >> dctx->second_shift_val)
 				);
@@ -577,159 +890,874 @@ void honokamiku_decrypt_block(
 	dctx->pos += buffer_size;
 }
 
-int honokamiku_jump_offset(
-	honokamiku_context *dctx,
-	unsigned int        offset
+void honokamiku_decrypt_block(
+	honokamiku_context  *dctx,
+	void                *buffer,
+	size_t               buffer_size
 )
 {
-	int reset_dctx;
-	unsigned int loop_times;
-	honokamiku_decrypt_mode decrypt_mode;
-	
-	reset_dctx = 0;
-	decrypt_mode = dctx->dm;
+	libhonoka__decrypt(dctx, (const char *) buffer, (char *) buffer, buffer_size);
+}
 
-	/* Check if the current context is V5 because */
-	/* seeking is not supported in V5 */
-	if (decrypt_mode == honokamiku_decrypt_version5)
-		return HONOKAMIKU_ERR_UNIMPLEMENTED;
-	
-	/* Check if we're seeking forward */
-	if (offset > dctx->pos)
-		loop_times = offset - dctx->pos;
-	else if (offset == dctx->pos)
-		/* Do nothing if the offset = pos*/
-		return HONOKAMIKU_ERR_OK;
-	else
-	{
-		/* Seeking backward */
-		loop_times = offset;
-		reset_dctx = 1;
-	}
+void honokamiku_decrypt_vector(
+	honokamiku_context     *dctx,
+	const honokamiku_iovec *segments,
+	size_t                  segment_count
+)
+{
+	size_t i = 0;
 
-	if (decrypt_mode == honokamiku_decrypt_none) {}
-	else if (decrypt_mode == honokamiku_decrypt_version1)
+	while (i < segment_count)
 	{
-		unsigned int c, n;
-		size_t i;
-		c = dctx->pos - (dctx->pos & 3);
-		n = offset - (offset & 3);
+		unsigned char block[8192];
+		size_t size = 0, j, k;
 
-		if(c > n)
-			/* subtract */
-			for(i = (c - n)>>2; i > 0; dctx->xor_key -= dctx->update_key, i--);
-		else if(n > c)
-			/* addition */
-			for(i = (c - n)>>2; i > 0; dctx->xor_key += dctx->update_key, i--);
-	}
-	else if (decrypt_mode == honokamiku_decrypt_version2)
-	{
-		if (reset_dctx)
-		{
-			dctx->update_key = dctx->init_key;
-			dctx->xor_key = ((dctx->init_key >> 23) & 255) |
-							((dctx->init_key >> 7) & 65280);
-		}
-		
-		if (dctx->pos % 2 == 1 && reset_dctx == 0)
+		/* Consecutive segments which fit in the block together */
+		for (j = i; j < segment_count && segments[j].buffer_size <= sizeof(block) - size; j++)
+			size += segments[j].buffer_size;
+
+		if (j - i < 2)
 		{
-			loop_times--;
-			honokamiku_update_v2(dctx);
+			/* Large or lone segment, decrypt it directly */
+			libhonoka__decrypt(dctx, (const char *) segments[i].buffer, (char *) segments[i].buffer, segments[i].buffer_size);
+			i++;
+			continue;
 		}
-		
-		loop_times /= 2;
-		
-		for(; loop_times != 0; loop_times--)
-			honokamiku_update_v2(dctx);
-	}
-	else if (
-		decrypt_mode == honokamiku_decrypt_version3 ||
-		decrypt_mode == honokamiku_decrypt_version4
-	)
-	{
-		/* V3 and V4 actually shares same jump method if we treat V3 as V4 */
-		/* which uses 2nd LCG keys (MSVC LCG parameters) */
-		if (reset_dctx)
-			dctx->xor_key = dctx->update_key = dctx->init_key;
-		
-		for(; loop_times != 0; loop_times--)
-			dctx->xor_key = (
-				dctx->update_key =
-					dctx->update_key *
-					dctx->mul_val +
-					dctx->add_val
-			);
-	}
-	else if (decrypt_mode == honokamiku_decrypt_version6)
-	{
-		/* There are 2 LCG which needs to be updated here */
-		if (reset_dctx)
+
+		/* Gather, decrypt at once, and scatter back */
+		for (size = 0, k = i; k < j; k++)
 		{
-			dctx->xor_key = dctx->update_key = dctx->init_key;
-			dctx->second_xor_key =
-			dctx->second_update_key =
-			dctx->second_init_key;
+			memcpy(block + size, segments[k].buffer, segments[k].buffer_size);
+			size += segments[k].buffer_size;
 		}
-		
-		for(; loop_times != 0; loop_times--)
+
+		libhonoka__decrypt(dctx, (const char *) block, (char *) block, size);
+
+		for (size = 0, k = i; k < j; k++)
 		{
-			dctx->xor_key = (
-				dctx->update_key =
-					dctx->update_key *
-					dctx->mul_val +
-					dctx->add_val
-			);
-			dctx->second_xor_key = (
-				dctx->second_update_key =
-					dctx->second_update_key *
-					dctx->second_mul_val +
-					dctx->second_add_val
-			);
+			memcpy(segments[k].buffer, block + size, segments[k].buffer_size);
+			size += segments[k].buffer_size;
 		}
+
+		i = j;
 	}
-	
-	dctx->pos = offset;
-	return HONOKAMIKU_ERR_OK;
 }
 
-int honokamiku_decrypt_init(
-	honokamiku_context      *dctx,
-	honokamiku_decrypt_mode  decrypt_mode,
-	honokamiku_gamefile_id   gid,
-	const char              *gpf,
-	const char              *filename,
-	const void              *file_header
+/*!
+ * Check if the file kernels decrypt the file: version 6 files if `second`
+ * is nonzero, version 3 and 4 files otherwise. Used internally
+ */
+static int libhonoka__files_match(
+	const honokamiku_context *dctx,
+	size_t                    buffer_size,
+	int                       second
 )
 {
-	if (
-		(gid != honokamiku_gamefile_unknown && gpf != NULL) ||
-		(gid == honokamiku_gamefile_unknown && gpf == NULL)
-	)
+	if (buffer_size < 16 || dctx->v3_initialized == 0)
+		return 0;
+
+	if (second)
+		return dctx->dm == honokamiku_decrypt_version6;
+
+	return
+		dctx->dm == honokamiku_decrypt_version3 ||
+		dctx->dm == honokamiku_decrypt_version4;
+}
+
+/*!
+ * Put LCG keys into lane `i` of file kernels state, see libhonoka__files.
+ * Used internally
+ */
+static void libhonoka__files_lcg(
+	unsigned int        (*keys)[4],
+	unsigned int        (*mul_val)[LIBHONOKA_FILES_MAX_LANES][4],
+	unsigned int        (*add_val)[LIBHONOKA_FILES_MAX_LANES][4],
+	unsigned int        (*shift_val)[4],
+	size_t                i,
+	unsigned int          key,
+	const libhonoka__lcg *lcg
+)
+{
+	unsigned int mul4, add4, jump_mul, jump_add;
+	size_t j, c;
+
+	libhonoka__lcg_lanes(key, lcg, keys[i], 4, &mul4, &add4);
+
+	/* The lane had a file with the same LCG */
+	if (mul_val[0][i][0] == mul4 && add_val[0][i][0] == add4 && shift_val[i][0] == lcg->shift_val)
+		return;
+
+	jump_mul = mul4;
+	jump_add = add4;
+
+	for (j = 0; j < 4; j++)
+	{
+		for (c = 0; c < 4; c++)
+		{
+			mul_val[j][i][c] = jump_mul;
+			add_val[j][i][c] = jump_add;
+		}
+
+		/* 4 steps further */
+		jump_add = mul4 * jump_add + add4;
+		jump_mul *= mul4;
+	}
+
+	for (c = 0; c < 4; c++)
+		shift_val[i][c] = lcg->shift_val;
+}
+
+/*!
+ * Put the keys of the file into lane `i` of file kernels state. Used
+ * internally
+ */
+static void libhonoka__files_load(
+	libhonoka__files         *files,
+	size_t                    i,
+	const honokamiku_context *dctx
+)
+{
+	libhonoka__lcg lcg;
+
+	libhonoka__get_lcg(dctx, &lcg, 0);
+	libhonoka__files_lcg(files->keys, files->mul_val, files->add_val, files->shift_val, i, dctx->update_key, &lcg);
+
+	if (dctx->dm == honokamiku_decrypt_version6)
+	{
+		libhonoka__get_lcg(dctx, &lcg, 1);
+		libhonoka__files_lcg(files->keys2, files->mul_val2, files->add_val2, files->shift_val2, i, dctx->second_update_key, &lcg);
+	}
+}
+
+/*!
+ * Move the keys of the file `size` bytes forward, as decrypting them does.
+ * Used internally
+ */
+static void libhonoka__files_seek(honokamiku_context *dctx, size_t size)
+{
+	/* LCGs repeat every 2^32 steps, so the truncated step count is fine */
+	dctx->xor_key = dctx->update_key = libhonoka__lcg_jump(
+		dctx->update_key,
+		dctx->mul_val,
+		dctx->add_val,
+		(unsigned int) size
+	);
+
+	if (dctx->dm == honokamiku_decrypt_version6)
+		dctx->second_xor_key = dctx->second_update_key = libhonoka__lcg_jump(
+			dctx->second_update_key,
+			dctx->second_mul_val,
+			dctx->second_add_val,
+			(unsigned int) size
+		);
+
+	dctx->pos += (unsigned int) size;
+}
+
+/*!
+ * Key `tail` bytes after the keys `tail_keys` of the incomplete last block
+ * in lane `i`, with the jumps of lane `i` in `mul_val` and `add_val`. Used
+ * internally
+ */
+static unsigned int libhonoka__files_tail_key(
+	const unsigned int *tail_keys,
+	unsigned int        (*mul_val)[LIBHONOKA_FILES_MAX_LANES][4],
+	unsigned int        (*add_val)[LIBHONOKA_FILES_MAX_LANES][4],
+	size_t              i,
+	size_t              tail
+)
+{
+	unsigned int key = tail_keys[tail & 3];
+
+	if (tail < 4)
+		return key;
+
+	return mul_val[(tail >> 2) - 1][i][0] * key + add_val[(tail >> 2) - 1][i][0];
+}
+
+/*!
+ * Set the keys of the file in lane `i` past its end, as decrypting it does,
+ * from the keys of its incomplete last block. Used internally
+ */
+static void libhonoka__files_end(
+	honokamiku_context *dctx,
+	libhonoka__files   *files,
+	size_t              i,
+	size_t              size
+)
+{
+	dctx->xor_key = dctx->update_key = libhonoka__files_tail_key(
+		files->tail_keys[i],
+		files->mul_val,
+		files->add_val,
+		i,
+		size & 15
+	);
+
+	if (dctx->dm == honokamiku_decrypt_version6)
+		dctx->second_xor_key = dctx->second_update_key = libhonoka__files_tail_key(
+			files->tail_keys2[i],
+			files->mul_val2,
+			files->add_val2,
+			i,
+			size & 15
+		);
+
+	dctx->pos += (unsigned int) size;
+}
+
+/*!
+ * Decrypt the files matched by libhonoka__files_match(), one file per lane
+ * of `kernel`. Each lane gets the next file as soon as its file ends. Used
+ * internally
+ */
+static void libhonoka__files_decrypt(
+	libhonoka__files_kernel kernel,
+	size_t                  lanes,
+	honokamiku_context     *dctxs,
+	const honokamiku_iovec *buffers,
+	size_t                  count,
+	int                     second
+)
+{
+	libhonoka__files files;
+	unsigned char *lane_buffers[LIBHONOKA_FILES_MAX_LANES];
+	size_t lane_blocks[LIBHONOKA_FILES_MAX_LANES]; /* Blocks left in lane */
+	size_t lane_files[LIBHONOKA_FILES_MAX_LANES];  /* File in lane, or `count` */
+	size_t next = 0, i;
+
+	/* Zeroed, as memory checkers flag computing with uninitialized keys */
+	/* even if the result is unused */
+	memset(&files, 0, sizeof(libhonoka__files));
+
+	for (i = 0; i < lanes; i++)
+	{
+		lane_buffers[i] = NULL;
+		lane_blocks[i] = 0;
+		lane_files[i] = count;
+	}
+
+	for (;;)
+	{
+		/* Fill free lanes */
+		for (i = 0; i < lanes; i++)
+		{
+			for (; lane_files[i] == count && next < count; next++)
+			{
+				if (libhonoka__files_match(&dctxs[next], buffers[next].buffer_size, second))
+				{
+					libhonoka__files_load(&files, i, &dctxs[next]);
+					lane_buffers[i] = (unsigned char *) buffers[next].buffer;
+					lane_blocks[i] = buffers[next].buffer_size >> 4;
+					lane_files[i] = next;
+				}
+			}
+		}
+
+		/* Lanes would be left idle from now on, so the files in lanes are */
+		/* finished one by one with the multi-lane kernels of a file */
+		if (next == count)
+			break;
+
+		kernel(&files, lane_buffers, lane_blocks, LIBHONOKA_FILES_STEP);
+
+		for (i = 0; i < lanes; i++)
+		{
+			const honokamiku_iovec *buffer = &buffers[lane_files[i]];
+			size_t tail = buffer->buffer_size & 15, j;
+
+			if (lane_blocks[i] >= LIBHONOKA_FILES_STEP)
+			{
+				lane_buffers[i] += LIBHONOKA_FILES_STEP << 4;
+				lane_blocks[i] -= LIBHONOKA_FILES_STEP;
+				continue;
+			}
+
+			/* The file has ended. Decrypt its incomplete last block */
+			for (j = 0; j < tail; j++)
+				lane_buffers[i][(lane_blocks[i] << 4) + j] ^= files.tail[i][j];
+
+			libhonoka__files_end(&dctxs[lane_files[i]], &files, i, buffer->buffer_size);
+			lane_files[i] = count;
+		}
+	}
+
+	/* Decrypt the rest of the files in lanes */
+	for (i = 0; i < lanes; i++)
+	{
+		if (lane_files[i] != count)
+		{
+			const honokamiku_iovec *buffer = &buffers[lane_files[i]];
+			size_t done = buffer->buffer_size - (buffer->buffer_size & 15) - (lane_blocks[i] << 4);
+
+			libhonoka__files_seek(&dctxs[lane_files[i]], done);
+			honokamiku_decrypt_block(&dctxs[lane_files[i]], lane_buffers[i], buffer->buffer_size - done);
+		}
+	}
+}
+
+void honokamiku_decrypt_many(
+	honokamiku_context     *dctxs,
+	const honokamiku_iovec *buffers,
+	size_t                  count
+)
+{
+	const libhonoka__kernels *kernels = libhonoka__get_kernels();
+	size_t i;
+
+	if (kernels->files_xor == NULL)
+	{
+		for (i = 0; i < count; i++)
+			honokamiku_decrypt_block(&dctxs[i], buffers[i].buffer, buffers[i].buffer_size);
+
+		return;
+	}
+
+	/* Version 3 and 4 files have 1 LCG, so they use the cheaper kernel */
+	libhonoka__files_decrypt(kernels->files_xor, kernels->files_lanes, dctxs, buffers, count, 0);
+	libhonoka__files_decrypt(kernels->files2_xor, kernels->files_lanes, dctxs, buffers, count, 1);
+
+	/* Other files one by one */
+	for (i = 0; i < count; i++)
+		if (
+			libhonoka__files_match(&dctxs[i], buffers[i].buffer_size, 0) == 0 &&
+			libhonoka__files_match(&dctxs[i], buffers[i].buffer_size, 1) == 0
+		)
+			honokamiku_decrypt_block(&dctxs[i], buffers[i].buffer, buffers[i].buffer_size);
+}
+
+void honokamiku_decrypt_copy(
+	honokamiku_context  *dctx,
+	const void          *src,
+	void                *dst,
+	size_t               buffer_size
+)
+{
+	const libhonoka__kernels *kernels = libhonoka__get_kernels();
+	const char *in = (const char *) src;
+	char *out = (char *) dst;
+
+	if (src == dst || buffer_size < LIBHONOKA_STREAM_MIN || kernels->stream_copy == NULL)
+	{
+		libhonoka__decrypt(dctx, in, out, buffer_size);
+		return;
+	}
+
+	/* Decrypt to a block that stays in L1 cache, then stream it out */
+	while (buffer_size > 0)
+	{
+		unsigned char block[16384];
+		size_t size = buffer_size < sizeof(block) ? buffer_size : sizeof(block);
+
+		libhonoka__decrypt(dctx, in, (char *) block, size);
+		kernels->stream_copy(block, (unsigned char *) out, size);
+		in += size;
+		out += size;
+		buffer_size -= size;
+	}
+}
+
+int honokamiku_keystream(
+	honokamiku_context *dctx,
+	void               *buffer,
+	size_t              buffer_size
+)
+{
+	/* Keystream is the decryption of zeros */
+	static const char zero[4096] = {0};
+	honokamiku_decrypt_mode dm = dctx->dm;
+	char *out = (char *) buffer;
+
+	if (
+		dm == honokamiku_decrypt_auto ||
+		dm > honokamiku_decrypt_version6 ||
+		(dm >= honokamiku_decrypt_version3 && dctx->v3_initialized == 0)
+	)
+		return HONOKAMIKU_ERR_INVALIDMETHOD;
+
+	/* Version 5 keys are same as version 4, without the chaining */
+	if (dm == honokamiku_decrypt_version5)
+		dctx->dm = honokamiku_decrypt_version4;
+
+	while (buffer_size > 0)
+	{
+		size_t size = buffer_size < sizeof(zero) ? buffer_size : sizeof(zero);
+
+		libhonoka__decrypt(dctx, zero, out, size);
+		out += size;
+		buffer_size -= size;
+	}
+
+	dctx->dm = dm;
+	return HONOKAMIKU_ERR_OK;
+}
+
+int honokamiku_jump_offset(
+	honokamiku_context *dctx,
+	unsigned int        offset
+)
+{
+	int reset_dctx;
+	unsigned int loop_times;
+	honokamiku_decrypt_mode decrypt_mode;
+	
+	reset_dctx = 0;
+	decrypt_mode = dctx->dm;
+
+	/* Check if the current context is V5 because V5 needs the */
+	/* previous byte to seek. See honokamiku_jump_offset_v5() */
+	if (decrypt_mode == honokamiku_decrypt_version5)
+	{
+		if (offset == dctx->pos)
+			return HONOKAMIKU_ERR_OK;
+
+		return offset == 0 ?
+			honokamiku_jump_offset_v5(dctx, 0, 0) :
+			HONOKAMIKU_ERR_UNIMPLEMENTED;
+	}
+	
+	/* Check if we're seeking forward */
+	if (offset > dctx->pos)
+		loop_times = offset - dctx->pos;
+	else if (offset == dctx->pos)
+		/* Do nothing if the offset = pos*/
+		return HONOKAMIKU_ERR_OK;
+	else
+	{
+		/* Seeking backward */
+		loop_times = offset;
+		reset_dctx = 1;
+	}
+
+	if (decrypt_mode == honokamiku_decrypt_none) {}
+	else if (decrypt_mode == honokamiku_decrypt_version1)
+		/* Key of every 4 bytes is incremented by update_key */
+		dctx->xor_key = dctx->init_key + (offset >> 2) * dctx->update_key;
+	else if (decrypt_mode == honokamiku_decrypt_version2)
+		/* Key is updated every 2 bytes. Odd offset uses the same key as */
+		/* the even offset before it, like honokamiku_decrypt_block() */
+		libhonoka__v2_jump(dctx, offset >> 1);
+	else if (
+		decrypt_mode == honokamiku_decrypt_version3 ||
+		decrypt_mode == honokamiku_decrypt_version4
+	)
+	{
+		/* V3 and V4 actually shares same jump method if we treat V3 as V4 */
+		/* which uses 2nd LCG keys (MSVC LCG parameters) */
+		if (reset_dctx)
+			dctx->update_key = dctx->init_key;
+
+		dctx->xor_key = dctx->update_key = libhonoka__lcg_jump(
+			dctx->update_key,
+			dctx->mul_val,
+			dctx->add_val,
+			loop_times
+		);
+	}
+	else if (decrypt_mode == honokamiku_decrypt_version6)
+	{
+		/* There are 2 LCG which needs to be updated here */
+		if (reset_dctx)
+		{
+			dctx->update_key = dctx->init_key;
+			dctx->second_update_key = dctx->second_init_key;
+		}
+
+		dctx->xor_key = dctx->update_key = libhonoka__lcg_jump(
+			dctx->update_key,
+			dctx->mul_val,
+			dctx->add_val,
+			loop_times
+		);
+		dctx->second_xor_key = dctx->second_update_key = libhonoka__lcg_jump(
+			dctx->second_update_key,
+			dctx->second_mul_val,
+			dctx->second_add_val,
+			loop_times
+		);
+	}
+	
+	dctx->pos = offset;
+	return HONOKAMIKU_ERR_OK;
+}
+
+int honokamiku_decrypt_at(
+	const honokamiku_context *dctx,
+	unsigned int              offset,
+	void                     *buffer,
+	size_t                    buffer_size
+)
+{
+	honokamiku_range range;
+
+	range.offset = offset;
+	range.buffer = buffer;
+	range.buffer_size = buffer_size;
+
+	return honokamiku_decrypt_ranges(dctx, &range, 1);
+}
+
+int honokamiku_decrypt_ranges(
+	const honokamiku_context *dctx,
+	const honokamiku_range   *ranges,
+	size_t                    range_count
+)
+{
+	/* Private copy, so the caller's context is never modified */
+	honokamiku_context local = *dctx;
+	size_t i;
+
+	for (i = 0; i < range_count; i++)
+	{
+		int ret = honokamiku_jump_offset(&local, ranges[i].offset);
+
+		if (ret != HONOKAMIKU_ERR_OK)
+			return ret;
+
+		libhonoka__decrypt(&local, (const char *) ranges[i].buffer, (char *) ranges[i].buffer, ranges[i].buffer_size);
+	}
+
+	return HONOKAMIKU_ERR_OK;
+}
+
+/*!
+ * Expand cursor into decrypter context. Used internally
+ */
+static void libhonoka__cursor_load(honokamiku_context *dctx, const honokamiku_cursor *cursor)
+{
+	const honokamiku_file_key *key = cursor->key;
+
+	dctx->dm = key->dm;
+	dctx->init_key = key->init_key;
+	dctx->shift_val = key->shift_val;
+	dctx->mul_val = key->mul_val;
+	dctx->add_val = key->add_val;
+	dctx->second_init_key = key->second_init_key;
+	dctx->second_shift_val = key->second_shift_val;
+	dctx->second_mul_val = key->second_mul_val;
+	dctx->second_add_val = key->second_add_val;
+	dctx->v3_initialized = 1;
+	dctx->v5_encrypt = key->v5_encrypt;
+
+	dctx->pos = cursor->pos;
+	dctx->update_key = cursor->update_key;
+	dctx->xor_key = cursor->xor_key;
+	dctx->second_update_key = cursor->second_update_key;
+	dctx->second_xor_key = cursor->second_xor_key;
+	dctx->v5_chain = cursor->v5_chain;
+}
+
+/*!
+ * Store the changing keys of decrypter context back to cursor. Used
+ * internally
+ */
+static void libhonoka__cursor_store(honokamiku_cursor *cursor, const honokamiku_context *dctx)
+{
+	cursor->pos = dctx->pos;
+	cursor->update_key = dctx->update_key;
+	cursor->xor_key = dctx->xor_key;
+	cursor->second_update_key = dctx->second_update_key;
+	cursor->second_xor_key = dctx->second_xor_key;
+	cursor->v5_chain = dctx->v5_chain;
+}
+
+int honokamiku_file_key_init(
+	honokamiku_file_key      *key,
+	const honokamiku_context *dctx
+)
+{
+	if (
+		dctx->dm == honokamiku_decrypt_auto ||
+		dctx->dm > honokamiku_decrypt_version6 ||
+		(dctx->dm >= honokamiku_decrypt_version3 && dctx->v3_initialized == 0)
+	)
+		return HONOKAMIKU_ERR_INVALIDMETHOD;
+
+	key->dm = dctx->dm;
+	key->init_key = dctx->init_key;
+	/* Only constant in version 1, the rest is reset by the cursor */
+	key->update_key = dctx->update_key;
+	key->shift_val = dctx->shift_val;
+	key->mul_val = dctx->mul_val;
+	key->add_val = dctx->add_val;
+	key->second_init_key = dctx->second_init_key;
+	key->second_shift_val = dctx->second_shift_val;
+	key->second_mul_val = dctx->second_mul_val;
+	key->second_add_val = dctx->second_add_val;
+	key->v5_encrypt = dctx->v5_encrypt;
+
+	return HONOKAMIKU_ERR_OK;
+}
+
+void honokamiku_cursor_init(
+	honokamiku_cursor         *cursor,
+	const honokamiku_file_key *key
+)
+{
+	cursor->key = key;
+	cursor->pos = 0;
+	cursor->update_key = 0;
+	cursor->xor_key = 0;
+	cursor->second_update_key = 0;
+	cursor->second_xor_key = 0;
+	cursor->v5_chain = 0;
+
+	/* Keys at position 0, same as honokamiku_decrypt_final_init() */
+	switch (key->dm)
+	{
+		case honokamiku_decrypt_version1:
+		{
+			cursor->update_key = key->update_key;
+			cursor->xor_key = key->init_key;
+			break;
+		}
+		case honokamiku_decrypt_version2:
+		{
+			cursor->update_key = key->init_key;
+			cursor->xor_key = ((key->init_key >> 23) & 255) | ((key->init_key >> 7) & 65280);
+			break;
+		}
+		case honokamiku_decrypt_version5:
+		{
+			/* Chained into the first byte */
+			cursor->v5_chain = 89;
+			cursor->xor_key = cursor->update_key = key->init_key;
+			break;
+		}
+		case honokamiku_decrypt_version6:
+		{
+			cursor->second_xor_key = cursor->second_update_key = key->second_init_key;
+			/* Primary LCG same as below */
+		}
+		case honokamiku_decrypt_version3:
+		case honokamiku_decrypt_version4:
+		{
+			cursor->xor_key = cursor->update_key = key->init_key;
+			break;
+		}
+		default: break;
+	}
+}
+
+void honokamiku_cursor_decrypt(
+	honokamiku_cursor *cursor,
+	void              *buffer,
+	size_t             buffer_size
+)
+{
+	honokamiku_context dctx;
+
+	libhonoka__cursor_load(&dctx, cursor);
+	libhonoka__decrypt(&dctx, (const char *) buffer, (char *) buffer, buffer_size);
+	libhonoka__cursor_store(cursor, &dctx);
+}
+
+int honokamiku_cursor_jump(
+	honokamiku_cursor *cursor,
+	unsigned int       offset,
+	unsigned char      prev_byte
+)
+{
+	honokamiku_context dctx;
+	int ret;
+
+	libhonoka__cursor_load(&dctx, cursor);
+	ret = honokamiku_jump_offset_v5(&dctx, offset, prev_byte);
+	libhonoka__cursor_store(cursor, &dctx);
+
+	return ret;
+}
+
+int honokamiku_jump_offset_v5(
+	honokamiku_context *dctx,
+	unsigned int        offset,
+	unsigned char       prev_byte
+)
+{
+	if (dctx->dm != honokamiku_decrypt_version5)
+		return honokamiku_jump_offset(dctx, offset);
+
+	/* The keys are same as V4, the previous byte is the only missing part */
+	dctx->xor_key = dctx->update_key = libhonoka__lcg_jump(
+		dctx->init_key,
+		dctx->mul_val,
+		dctx->add_val,
+		offset
+	);
+	dctx->v5_chain = offset ? prev_byte : 89;
+	dctx->pos = offset;
+
+	return HONOKAMIKU_ERR_OK;
+}
+
+/*!
+ * Get the prefix of game file, or NULL if both or none of them are given.
+ * Used internally
+ */
+static const char *libhonoka__gamefile_prefix(
+	honokamiku_gamefile_id  gid,
+	const char             *gpf
+)
+{
+	if (
+		(gid != honokamiku_gamefile_unknown && gpf != NULL) ||
+		(gid == honokamiku_gamefile_unknown && gpf == NULL)
+	)
 		/* Only one of them can be zero/NULL */
+		return NULL;
+
+	if (gpf != NULL)
+		return gpf;
+
+	switch (gid)
+	{
+		case honokamiku_gamefile_en:
+			return HONOKAMIKU_KEY_SIF_EN;
+		case honokamiku_gamefile_jp:
+			return HONOKAMIKU_KEY_SIF_JP;
+		case honokamiku_gamefile_tw:
+			return HONOKAMIKU_KEY_SIF_TW;
+		case honokamiku_gamefile_cn:
+			return HONOKAMIKU_KEY_SIF_CN;
+		default:
+			return NULL;
+	}
+}
+
+int honokamiku_decrypt_init(
+	honokamiku_context      *dctx,
+	honokamiku_decrypt_mode  decrypt_mode,
+	honokamiku_gamefile_id   gid,
+	const char              *gpf,
+	const char              *filename,
+	const void              *file_header
+)
+{
+	gpf = libhonoka__gamefile_prefix(gid, gpf);
+	if (gpf == NULL)
 		return HONOKAMIKU_ERR_INVALIDARG;
+	
+	return honokamiku_dinit(dctx, decrypt_mode, gpf, filename, file_header);
+}
 
+int honokamiku_decrypt_init_batch(
+	honokamiku_context      *dctxs,
+	int                     *results,
+	size_t                   count,
+	honokamiku_decrypt_mode  decrypt_mode,
+	honokamiku_gamefile_id   gid,
+	const char              *gpf,
+	const char *const       *filenames,
+	const void *const       *file_headers
+)
+{
+	libhonoka__md5_message messages[64];
+	unsigned char digests[64 * 16];
+	size_t prefix_size, i, j;
+
+	gpf = libhonoka__gamefile_prefix(gid, gpf);
 	if (gpf == NULL)
+		return HONOKAMIKU_ERR_INVALIDARG;
+
+	prefix_size = strlen(gpf);
+
+	for (i = 0; i < count; i += 64)
 	{
-		switch (gid)
+		size_t group = count - i < 64 ? count - i : 64;
+
+		for (j = 0; j < group; j++)
 		{
-			case honokamiku_gamefile_en:
-				gpf = HONOKAMIKU_KEY_SIF_EN;
-				break;
-			case honokamiku_gamefile_jp:
-				gpf = HONOKAMIKU_KEY_SIF_JP;
-				break;
-			case honokamiku_gamefile_tw:
-				gpf = HONOKAMIKU_KEY_SIF_TW;
-				break;
-			case honokamiku_gamefile_cn:
-				gpf = HONOKAMIKU_KEY_SIF_CN;
-				break;
-			default:
-				return HONOKAMIKU_ERR_INVALIDARG;
+			messages[j].prefix = gpf;
+			messages[j].prefix_size = prefix_size;
+			messages[j].name = libhonoka__basename(filenames[i + j]);
+			messages[j].name_size = strlen(messages[j].name);
 		}
+
+		libhonoka__md5_many(messages, group, digests);
+
+		for (j = 0; j < group; j++)
+			results[i + j] = libhonoka__dinit_digest(
+				&dctxs[i + j],
+				decrypt_mode,
+				gpf,
+				messages[j].name_size,
+				digests + j * 16,
+				file_headers[i + j]
+			);
 	}
-	
-	return honokamiku_dinit(dctx, decrypt_mode, gpf, filename, file_header);
+
+	return HONOKAMIKU_ERR_OK;
+}
+
+honokamiku_gamefile_id honokamiku_decrypt_init_detect(
+	honokamiku_context      *dctx,
+	const char              *filename,
+	const void              *file_header,
+	honokamiku_decrypt_mode *decrypt_mode
+)
+{
+	const unsigned char *header = (const unsigned char *) file_header;
+	libhonoka__md5_message messages[4];
+	unsigned char digests[4 * 16];
+	size_t filename_size;
+	int i, step = 1;
+
+	filename = libhonoka__basename(filename);
+	filename_size = strlen(filename);
+
+	/* File name with all known game file prefixes */
+	for (i = 0; i < 4; i++)
+	{
+		messages[i].prefix = libhonoka__gamefile_prefix((honokamiku_gamefile_id) (i + 1), NULL);
+		messages[i].prefix_size = strlen(messages[i].prefix);
+		messages[i].name = filename;
+		messages[i].name_size = filename_size;
+	}
+
+	for (i = 0; i < 4; i++)
+	{
+		const unsigned char *digest = digests + i * 16;
+
+		/* Most files are EN/WW or JP ones, so those prefixes are tried */
+		/* alone first. The rest are hashed at once with multi-lane MD5, */
+		/* or one by one without it */
+		if (i < 2)
+			libhonoka__md5_many(messages + i, 1, digests + i * 16);
+		else if (i == 2)
+		{
+			step = libhonoka__get_md5_kernels(2)->md5 != NULL ? 2 : 1;
+			libhonoka__md5_many(messages + 2, step, digests + 32);
+		}
+		else if (step == 1)
+			libhonoka__md5_many(messages + 3, 1, digests + 48);
+
+		/* Same order as trying the game IDs one by one, V2 before V3+ */
+		if (
+			memcmp(digest + 4, header, 4) == 0 ||
+			((digest[4] ^ header[0]) & (digest[5] ^ header[1]) & (digest[6] ^ header[2])) == 255
+		)
+		{
+			libhonoka__dinit_digest(
+				dctx,
+				honokamiku_decrypt_auto,
+				messages[i].prefix,
+				filename_size,
+				digest,
+				file_header
+			);
+
+			if (decrypt_mode)
+				*decrypt_mode = dctx->dm;
+
+			return (honokamiku_gamefile_id) (i + 1);
+		}
+	}
+
+	memset(dctx, 0, sizeof(honokamiku_context));
+	if (decrypt_mode)
+		*decrypt_mode = honokamiku_decrypt_none;
+
+	return honokamiku_gamefile_unknown;
 }
 
 honokamiku_gamefile_id honokamiku_decrypt_init_auto(
@@ -738,15 +1766,110 @@ honokamiku_gamefile_id honokamiku_decrypt_init_auto(
 	const void			*file_header
 )
 {
-	honokamiku_gamefile_id gid;
-	
-	/* Loop through all known game IDs*/
-	for (gid = honokamiku_gamefile_en; gid <= honokamiku_gamefile_cn; gid++)
+	return honokamiku_decrypt_init_detect(dctx, filename, file_header, NULL);
+}
+
+int honokamiku_decrypt_init_many(
+	honokamiku_context           *dctxs,
+	int                          *results,
+	honokamiku_gamefile_id       *gids,
+	const honokamiku_file_record *files,
+	size_t                        count,
+	honokamiku_gamefile_id        gid
+)
+{
+	libhonoka__md5_message messages[64];
+	unsigned char digests[64 * 16];
+	const char *names[64];
+	size_t name_sizes[64];
+	size_t pending[64];
+	size_t i, j;
+	int first, last, g;
+
+	if (gid == honokamiku_gamefile_unknown)
 	{
-		if (honokamiku_decrypt_init(dctx, honokamiku_decrypt_auto, gid, NULL, filename, file_header) == HONOKAMIKU_ERR_OK)
-			return gid;
+		/* Try all known game files */
+		first = honokamiku_gamefile_en;
+		last = honokamiku_gamefile_cn;
 	}
-	return honokamiku_gamefile_unknown;
+	else if (libhonoka__gamefile_prefix(gid, NULL) != NULL)
+		first = last = gid;
+	else
+		return HONOKAMIKU_ERR_INVALIDARG;
+
+	for (i = 0; i < count; i += 64)
+	{
+		size_t group = count - i < 64 ? count - i : 64;
+		size_t pending_count = group;
+
+		for (j = 0; j < group; j++)
+		{
+			names[j] = libhonoka__basename(files[i + j].filename);
+			name_sizes[j] = strlen(names[j]);
+			pending[j] = j;
+		}
+
+		for (g = first; g <= last && pending_count > 0; g++)
+		{
+			const char *prefix = libhonoka__gamefile_prefix((honokamiku_gamefile_id) g, NULL);
+			size_t prefix_size = strlen(prefix);
+			size_t left = 0;
+
+			for (j = 0; j < pending_count; j++)
+			{
+				messages[j].prefix = prefix;
+				messages[j].prefix_size = prefix_size;
+				messages[j].name = names[pending[j]];
+				messages[j].name_size = name_sizes[pending[j]];
+			}
+
+			libhonoka__md5_many(messages, pending_count, digests);
+
+			for (j = 0; j < pending_count; j++)
+			{
+				size_t n = i + pending[j];
+
+				if (libhonoka__dinit_digest(
+					&dctxs[n],
+					honokamiku_decrypt_auto,
+					prefix,
+					messages[j].name_size,
+					digests + j * 16,
+					files[n].file_header
+				) != HONOKAMIKU_ERR_OK)
+				{
+					/* Try next game file */
+					pending[left++] = pending[j];
+					continue;
+				}
+
+				results[n] = honokamiku_decrypt_final_init(
+					&dctxs[n],
+					(honokamiku_gamefile_id) g,
+					NULL,
+					-1,
+					names[pending[j]],
+					(const char *) files[n].file_header + 4
+				);
+
+				if (gids)
+					gids[n] = (honokamiku_gamefile_id) g;
+			}
+
+			pending_count = left;
+		}
+
+		/* No known game file matches */
+		for (j = 0; j < pending_count; j++)
+		{
+			results[i + pending[j]] = HONOKAMIKU_ERR_DECRYPTUNKNOWN;
+
+			if (gids)
+				gids[i + pending[j]] = honokamiku_gamefile_unknown;
+		}
+	}
+
+	return HONOKAMIKU_ERR_OK;
 }
 
 int honokamiku_decrypt_final_init(
@@ -884,6 +2007,7 @@ int honokamiku_decrypt_final_init(
 		dctx->add_val = keys->increment;
 		dctx->mul_val = keys->multipler;
 		dctx->shift_val = keys->shift;
+		dctx->v5_chain = 89;
 		dctx->v3_initialized = 1;
 
 		return HONOKAMIKU_ERR_OK;
@@ -17,6 +17,15 @@
 #	define _HMIMP
 #endif
 
+/* Structure alignment, put between `struct` and its name */
+#if defined(_MSC_VER)
+#	define _HMALIGN(n) __declspec(align(n))
+#elif defined(__GNUC__)
+#	define _HMALIGN(n) __attribute__ ((aligned (n)))
+#else
+#	define _HMALIGN(n)
+#endif
+
 #if defined(HONOKAMIKU_SHARED)
 #	if defined(HONOKAMIKU_DECRYPTER_CORE)
 #		define HMAPI _HMEXP
@@ -122,8 +131,99 @@ typedef struct honokamiku_context
 	char         v5_encrypt;       /*!< Does we're encrypting in V5 instead?
                                         V5 has different algorithm for
                                         encryption and decryption. */
+	unsigned char v5_chain;        /*!< Version 5: Previous encrypted byte,
+                                        which is chained into the next byte */
 } honokamiku_context;
 
+/*!
+ * Read-only key of a file, taken from a decrypter context. Can be shared by
+ * any amount of honokamiku_cursor, also from multiple threads.
+ * \sa honokamiku_file_key_init()
+ */
+typedef struct honokamiku_file_key
+{
+	honokamiku_decrypt_mode dm;    /*!< Decryption version */
+	unsigned int init_key;         /*!< Key used at pos 0 */
+	unsigned int update_key;       /*!< Version 1: key increment */
+	unsigned int shift_val;        /*!< Version 3+: LCG shift value */
+	unsigned int mul_val;          /*!< Version 3+: LCG multiply value */
+	unsigned int add_val;          /*!< Version 3+: LCG increment value */
+	unsigned int second_init_key;  /*!< Version 6+: Secondary initialization
+                                        key */
+	unsigned int second_shift_val; /*!< Version 6+: Secondary LCG shift value*/
+	unsigned int second_mul_val;   /*!< Version 6+: Secondary LCG multiply
+                                        value */
+	unsigned int second_add_val;   /*!< Version 6+: Secondary LCG increment
+                                        value */
+	char         v5_encrypt;       /*!< Version 5: Encrypting instead? */
+} honokamiku_file_key;
+
+/*!
+ * Position in a file with honokamiku_file_key. Only holds the keys which
+ * change while decrypting, in 32 bytes aligned to 32 bytes, so a cursor
+ * never straddles cache lines. `malloc` only guarantees 16 bytes alignment:
+ * allocate arrays of cursors with `aligned_alloc`, `posix_memalign` or
+ * `_aligned_malloc` and 32 or 64 bytes alignment to keep that.
+ * \sa honokamiku_cursor_init()
+ */
+typedef struct _HMALIGN(32) honokamiku_cursor
+{
+	const honokamiku_file_key *key; /*!< Key of the file */
+	unsigned int pos;               /*!< Current position */
+	unsigned int update_key;        /*!< Current key at `pos` */
+	unsigned int xor_key;           /*!< Values to use when XOR-ing bytes */
+	unsigned int second_update_key; /*!< Version 6+: Secondary update key */
+	unsigned int second_xor_key;    /*!< Version 6+: Secondary value used when
+                                         XOR-ing bytes */
+	unsigned char v5_chain;         /*!< Version 5: Previous encrypted byte */
+} honokamiku_cursor;
+
+/*!
+ * Worker thread pool, for decrypting a single buffer with multiple threads.
+ * Reusable across calls.
+ * \sa honokamiku_pool_create()
+ * \sa honokamiku_decrypt_block_parallel()
+ */
+typedef struct honokamiku_pool honokamiku_pool;
+
+/*!
+ * Buffer segment for honokamiku_decrypt_vector(), or file buffer for
+ * honokamiku_decrypt_many(). Same layout as POSIX `struct iovec`.
+ */
+typedef struct honokamiku_iovec
+{
+	void   *buffer;      /*!< Segment contents */
+	size_t  buffer_size; /*!< Size of `buffer` */
+} honokamiku_iovec;
+
+/*!
+ * Range of file for honokamiku_decrypt_ranges().
+ */
+typedef struct honokamiku_range
+{
+	unsigned int  offset;      /*!< Absolute position of `buffer` */
+	void         *buffer;      /*!< Range contents */
+	size_t        buffer_size; /*!< Size of `buffer` */
+} honokamiku_range;
+
+/*!
+ * File of honokamiku_decrypt_init_many().
+ */
+typedef struct honokamiku_file_record
+{
+	const char *filename;    /*!< File name. Directories are ignored */
+	const void *file_header; /*!< First 16-bytes contents of the file */
+} honokamiku_file_record;
+
+/*!
+ * Cache of version 3 keystream, shared between decrypter contexts with same
+ * keys. Can live in memory shared between processes.
+ * \sa honokamiku_keycache_create()
+ * \sa honokamiku_keycache_init()
+ * \sa honokamiku_decrypt_block_cached()
+ */
+typedef struct honokamiku_keycache honokamiku_keycache;
+
 /******************************************************************************
 ** Functions                                                                 **
 ******************************************************************************/
@@ -151,6 +251,15 @@ HMAPI size_t honokamiku_context_size();
  */
 HMAPI size_t honokamiku_header_size(honokamiku_decrypt_mode decrypt_mode);
 
+/*!
+ * Returns name of the instruction set used by honokamiku_decrypt_block():
+ * "scalar", "sse2", "avx2", "avx512", or "neon". The fastest one the CPU supports is
+ * selected, unless `HONOKAMIKU_KERNEL` environment variable names another
+ * supported one (e.g. `HONOKAMIKU_KERNEL=scalar`). Useful for benchmarking.
+ * "neon" is only used when selected this way.
+ */
+HMAPI const char *honokamiku_kernel_name();
+
 /*!
  * \brief Initialize HonokaMiku decrypter context to decrypt a file.
  * \param decrypter_context HonokaMiku decrypter context to be initialized
@@ -183,6 +292,39 @@ HMAPI int honokamiku_decrypt_init(
 	const void              *file_header
 );
 
+/*!
+ * \brief Initialize many HonokaMiku decrypter contexts of same game file.
+ *
+ * Same as calling honokamiku_decrypt_init() for each file, but the MD5 of
+ * multiple file names is computed at once with SIMD, and the arguments are
+ * validated once.
+ * \param decrypter_contexts Array of \a count decrypter contexts to be
+ *                           initialized
+ * \param results Array of \a count results of honokamiku_decrypt_init(), one
+ *                for each file
+ * \param count Amount of files
+ * \param decrypt_mode Decryption mode of the files
+ * \param gamefile_id Game file to decrypt
+ * \param gamefile_prefix Game file prefix
+ * \param filenames Array of \a count file names
+ * \param file_headers Array of \a count file headers (first 4-bytes contents
+ *                     of each file)
+ * \returns #HONOKAMIKU_ERR_OK, or #HONOKAMIKU_ERR_INVALIDARG if
+ *          \a gamefile_id and \a gamefile_prefix are invalid, same as
+ *          honokamiku_decrypt_init(). \a results is not set then.
+ * \sa honokamiku_decrypt_init()
+ */
+HMAPI int honokamiku_decrypt_init_batch(
+	honokamiku_context      *decrypter_contexts,
+	int                     *results,
+	size_t                   count,
+	honokamiku_decrypt_mode  decrypt_mode,
+	honokamiku_gamefile_id   gamefile_id,
+	const char              *gamefile_prefix,
+	const char *const       *filenames,
+	const void *const       *file_headers
+);
+
 /*!
  * \brief Initialize HonokaMiku decrypter context with all possible known game
  *        ID.
@@ -201,6 +343,71 @@ HMAPI honokamiku_gamefile_id honokamiku_decrypt_init_auto(
 	const void         *file_header
 );
 
+/*!
+ * \brief Initialize HonokaMiku decrypter context with all possible known game
+ *        ID and report the detected decryption mode.
+ *
+ * Same as honokamiku_decrypt_init_auto(), but also reports the decryption
+ * mode. The SIF EN/WW and JP prefixes are tried first, then the file name
+ * is hashed with the TW and CN prefixes at once with SIMD.
+ * \param decrypter_context HonokaMiku decrypter context to be initialized
+ * \param filename File name that want to be decrypted
+ * \param file_header The first 4-bytes contents of the file
+ * \param decrypt_mode Pointer to store the detected decryption mode, or NULL.
+ *                     ::honokamiku_decrypt_version2 for version 2 files,
+ *                     ::honokamiku_decrypt_auto for version 3 and later files
+ *                     which needs honokamiku_decrypt_final_init(), or
+ *                     ::honokamiku_decrypt_none if the game file is unknown.
+ * \returns One of honokamiku_gamefile_id values. ::honokamiku_gamefile_unknown
+ *          if no suitable decryption method is found.
+ * \sa honokamiku_decrypt_init_auto()
+ * \sa honokamiku_decrypt_final_init()
+ */
+HMAPI honokamiku_gamefile_id honokamiku_decrypt_init_detect(
+	honokamiku_context      *decrypter_context,
+	const char              *filename,
+	const void              *file_header,
+	honokamiku_decrypt_mode *decrypt_mode
+);
+
+/*!
+ * \brief Fully initialize HonokaMiku decrypter contexts of many files.
+ *
+ * Same as calling honokamiku_decrypt_init() (or
+ * honokamiku_decrypt_init_auto()) then honokamiku_decrypt_final_init() for
+ * each file, but the MD5 of multiple file names is computed at once with
+ * SIMD, and the arguments are validated once. When detecting the game file,
+ * only the files not matched yet are hashed with the next game file prefix.
+ * \param decrypter_contexts Array of \a count decrypter contexts to be
+ *                           initialized
+ * \param results Array of \a count HONOKAMIKU_ERR_* results, one for each
+ *                file. #HONOKAMIKU_ERR_DECRYPTUNKNOWN if no known game file
+ *                matches.
+ * \param gamefile_ids Array of \a count game file of each file, or NULL.
+ *                     ::honokamiku_gamefile_unknown if no known game file
+ *                     matches.
+ * \param files Array of \a count files
+ * \param count Amount of files
+ * \param gamefile_id Game file to decrypt, or ::honokamiku_gamefile_unknown
+ *                    to detect the game file of each file
+ * \returns #HONOKAMIKU_ERR_OK, or #HONOKAMIKU_ERR_INVALIDARG if
+ *          \a gamefile_id is invalid. \a results is not set then.
+ * \note All 16 bytes of the file header must be readable, even for version 2
+ *       files which use only the first 4 bytes. Custom game file prefix and
+ *       key tables are not supported, use honokamiku_decrypt_init_batch()
+ *       then honokamiku_decrypt_final_init() instead.
+ * \sa honokamiku_decrypt_init_auto()
+ * \sa honokamiku_decrypt_final_init()
+ */
+HMAPI int honokamiku_decrypt_init_many(
+	honokamiku_context           *decrypter_contexts,
+	int                          *results,
+	honokamiku_gamefile_id       *gamefile_ids,
+	const honokamiku_file_record *files,
+	size_t                        count,
+	honokamiku_gamefile_id        gamefile_id
+);
+
 /*!
  * \brief Second-phase decrypter context initialization
  * \param decrypter_context HonokaMiku decrypter context
@@ -289,13 +496,102 @@ HMAPI void honokamiku_decrypt_block(
 	size_t              buffer_size
 );
 
+/*!
+ * \brief Decrypt list of buffer segments as one contiguous stream.
+ *
+ * Same as calling honokamiku_decrypt_block() for each segment in order, but
+ * consecutive small segments are gathered and decrypted at once, so the
+ * keystream setup is done once for all of them.
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init()
+ * \param segments Buffer segments to be decrypted in-place
+ * \param segment_count Amount of segments in \a segments
+ * \sa honokamiku_decrypt_block()
+ */
+HMAPI void honokamiku_decrypt_vector(
+	honokamiku_context     *decrypter_context,
+	const honokamiku_iovec *segments,
+	size_t                  segment_count
+);
+
+/*!
+ * \brief Decrypt many files at once.
+ *
+ * Same as calling honokamiku_decrypt_block() for each file, but version 3, 4
+ * and 6 files of 16 bytes or more are decrypted together, one file per 128
+ * bits of the SIMD registers, when the CPU supports AVX2. A lane takes the
+ * next file as soon as its file ends, so files of any size mix well. The
+ * other files are decrypted one by one.
+ * \param decrypter_contexts Array of \a count decrypter contexts that already
+ *                           initialized, one for each file
+ * \param buffers Array of \a count buffers to be decrypted in-place
+ * \param count Amount of files
+ * \sa honokamiku_decrypt_block()
+ * \sa honokamiku_decrypt_init_many()
+ */
+HMAPI void honokamiku_decrypt_many(
+	honokamiku_context     *decrypter_contexts,
+	const honokamiku_iovec *buffers,
+	size_t                  count
+);
+
+/*!
+ * \brief Same as honokamiku_decrypt_block(), but read the contents from
+ *        \a src and write the result to \a dst.
+ *
+ * Reads and writes every byte once, so read-only buffers like memory-mapped
+ * files can be decrypted without copying them first. Large buffers are
+ * written with non-temporal stores, if the CPU supports them, so they don't
+ * evict other data from the cache.
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init()
+ * \param src Buffer to be decrypted
+ * \param dst Buffer to store the result. Can be same as \a src, but must not
+ *            overlap it otherwise
+ * \param buffer_size Size of \a src and \a dst
+ * \sa honokamiku_decrypt_block()
+ */
+HMAPI void honokamiku_decrypt_copy(
+	honokamiku_context *decrypter_context,
+	const void         *src,
+	void               *dst,
+	size_t              buffer_size
+);
+
+/*!
+ * \brief Write the keystream at the current position of decrypter context,
+ *        and advance its position.
+ *
+ * Decrypting is XOR-ing the file contents with the keystream, so callers can
+ * generate the keystream ahead of time and XOR it later.
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init()
+ * \param buffer Buffer to store the keystream
+ * \param buffer_size Size of `buffer`
+ * \returns #HONOKAMIKU_ERR_OK on success, #HONOKAMIKU_ERR_INVALIDMETHOD if
+ *          the decrypter context is not initialized, or is version 3 and
+ *          later without honokamiku_decrypt_final_init()
+ * \note Version 5 also XORs the previous encrypted byte, which is not part of
+ *       the keystream. Decrypted byte is `keystream[i] ^ encrypted[i] ^
+ *       encrypted[i - 1]`. The previous encrypted byte stored in the
+ *       decrypter context is not updated, so use honokamiku_jump_offset_v5()
+ *       before calling honokamiku_decrypt_block() with it again.
+ * \sa honokamiku_decrypt_block()
+ */
+HMAPI int honokamiku_keystream(
+	honokamiku_context *decrypter_context,
+	void               *buffer,
+	size_t              buffer_size
+);
+
 /*!
  * \brief Recalculate decrypter context to decrypt at specific position.
  * \param decrypter_context HonokaMiku decrypter context to set it's position
  * \param offset Absolute position (starts at 0)
  * \returns #HONOKAMIKU_ERR_OK on success, #HONOKAMIKU_ERR_UNIMPLEMENTED if
  *          decrypter context doesn't support seeking
- * \todo Version 1 decryption jump
+ * \note Version 5 decrypter context can only seek to 0 or its current
+ *       position here. Use honokamiku_jump_offset_v5() for other offsets.
  * \sa honokamiku_context
  * \sa honokamiku_decrypt_init()
  * \sa honokamiku_decrypt_mode
@@ -305,6 +601,273 @@ HMAPI int honokamiku_jump_offset(
 	unsigned int        offset
 );
 
+/*!
+ * \brief Recalculate decrypter context to decrypt at specific position,
+ *        including version 5 decrypter context.
+ * \param decrypter_context HonokaMiku decrypter context to set it's position
+ * \param offset Absolute position (starts at 0)
+ * \param prev_byte Encrypted byte at \a offset - 1. Ignored if \a offset is
+ *                  0 or the decrypter context is not version 5
+ * \returns #HONOKAMIKU_ERR_OK on success, #HONOKAMIKU_ERR_UNIMPLEMENTED if
+ *          decrypter context doesn't support seeking
+ * \note Version 5 chains every encrypted byte into the next one, so it can
+ *       only seek if the encrypted byte before \a offset is known. When
+ *       decrypting chunks of one buffer in parallel, take \a prev_byte
+ *       before the preceding chunk is decrypted in-place.
+ * \sa honokamiku_jump_offset()
+ */
+HMAPI int honokamiku_jump_offset_v5(
+	honokamiku_context *decrypter_context,
+	unsigned int        offset,
+	unsigned char       prev_byte
+);
+
+/*!
+ * \brief Decrypt part of file at specific position, without modifying the
+ *        decrypter context.
+ *
+ * Works like `pread()`: multiple threads can decrypt different parts of the
+ * same file with one decrypter context at the same time.
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init()
+ * \param offset Absolute position of \a buffer (starts at 0)
+ * \param buffer Buffer to be decrypted
+ * \param buffer_size Size of `buffer`
+ * \returns #HONOKAMIKU_ERR_OK on success, #HONOKAMIKU_ERR_UNIMPLEMENTED if
+ *          decrypter context can't seek to \a offset
+ * \note Version 5 decrypter context can only decrypt at 0 or its current
+ *       position, like honokamiku_jump_offset().
+ * \sa honokamiku_decrypt_ranges()
+ */
+HMAPI int honokamiku_decrypt_at(
+	const honokamiku_context *decrypter_context,
+	unsigned int              offset,
+	void                     *buffer,
+	size_t                    buffer_size
+);
+
+/*!
+ * \brief Decrypt multiple parts of file, without modifying the decrypter
+ *        context.
+ *
+ * Same as calling honokamiku_decrypt_at() for each range, but each range
+ * continues from the end of the previous one, so ranges sorted by offset
+ * only seek forward.
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init()
+ * \param ranges Ranges to be decrypted
+ * \param range_count Amount of ranges in \a ranges
+ * \returns #HONOKAMIKU_ERR_OK on success, #HONOKAMIKU_ERR_UNIMPLEMENTED if
+ *          decrypter context can't seek to one of the ranges. Ranges before
+ *          it are already decrypted.
+ * \note Version 5 ranges must start at 0, the decrypter context position,
+ *       or the end of the previous range.
+ * \sa honokamiku_decrypt_at()
+ */
+HMAPI int honokamiku_decrypt_ranges(
+	const honokamiku_context *decrypter_context,
+	const honokamiku_range   *ranges,
+	size_t                    range_count
+);
+
+/*!
+ * \brief Take the read-only key of a file from decrypter context.
+ * \param key Pointer to file key to be initialized
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init(), at any
+ *                          position
+ * \returns #HONOKAMIKU_ERR_OK on success, #HONOKAMIKU_ERR_INVALIDMETHOD if
+ *          the decrypter context is not fully initialized
+ * \sa honokamiku_cursor_init()
+ */
+HMAPI int honokamiku_file_key_init(
+	honokamiku_file_key      *key,
+	const honokamiku_context *decrypter_context
+);
+
+/*!
+ * \brief Initialize cursor at position 0 of file.
+ * \param cursor Pointer to cursor to be initialized
+ * \param key File key initialized with honokamiku_file_key_init(). Must stay
+ *            valid while the cursor is used
+ */
+HMAPI void honokamiku_cursor_init(
+	honokamiku_cursor         *cursor,
+	const honokamiku_file_key *key
+);
+
+/*!
+ * \brief Same as honokamiku_decrypt_block(), but with cursor.
+ * \param cursor Cursor initialized with honokamiku_cursor_init()
+ * \param buffer Buffer to be decrypted
+ * \param buffer_size Size of `buffer`
+ */
+HMAPI void honokamiku_cursor_decrypt(
+	honokamiku_cursor *cursor,
+	void              *buffer,
+	size_t             buffer_size
+);
+
+/*!
+ * \brief Same as honokamiku_jump_offset_v5(), but with cursor.
+ * \param cursor Cursor initialized with honokamiku_cursor_init()
+ * \param offset Absolute position (starts at 0)
+ * \param prev_byte Version 5: Encrypted byte at \a offset - 1
+ * \returns #HONOKAMIKU_ERR_OK on success, #HONOKAMIKU_ERR_UNIMPLEMENTED if
+ *          the file key doesn't support seeking
+ */
+HMAPI int honokamiku_cursor_jump(
+	honokamiku_cursor *cursor,
+	unsigned int       offset,
+	unsigned char      prev_byte
+);
+
+/*!
+ * \brief Create worker thread pool.
+ * \param thread_count Amount of threads, including the thread which calls
+ *                     honokamiku_decrypt_block_parallel(). 0 means the
+ *                     amount of CPUs.
+ * \returns Worker thread pool, or NULL if there's not enough memory. Free
+ *          it with honokamiku_pool_free()
+ * \note If libhonoka is compiled with `HONOKAMIKU_NO_THREADS`, the pool
+ *       always has 1 thread.
+ * \sa honokamiku_decrypt_block_parallel()
+ */
+HMAPI honokamiku_pool *honokamiku_pool_create(size_t thread_count);
+
+/*!
+ * \brief Stop the threads and free worker thread pool.
+ * \param pool Worker thread pool to free. Can be NULL.
+ */
+HMAPI void honokamiku_pool_free(honokamiku_pool *pool);
+
+/*!
+ * \brief Get amount of threads in worker thread pool.
+ * \param pool Worker thread pool
+ * \returns Amount of threads, including the calling thread.
+ */
+HMAPI size_t honokamiku_pool_thread_count(const honokamiku_pool *pool);
+
+/*!
+ * \brief Set minimum amount of bytes each thread decrypts.
+ *
+ * Buffers smaller than twice of this are decrypted by the calling thread
+ * only, as waking up the other threads costs more than it saves.
+ * \param pool Worker thread pool
+ * \param min_chunk Minimum chunk size. 0 means the default, 256KB
+ * \sa honokamiku_decrypt_block_parallel()
+ */
+HMAPI void honokamiku_pool_set_min_chunk(honokamiku_pool *pool, size_t min_chunk);
+
+/*!
+ * \brief Same as honokamiku_decrypt_block(), but split large buffers
+ *        between threads of \a pool.
+ * \param pool Worker thread pool. If it's NULL, this function is same as
+ *             honokamiku_decrypt_block()
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init()
+ * \param buffer Buffer to be decrypted
+ * \param buffer_size Size of `buffer`
+ * \note Each thread seeks its own copy of the decrypter context to its
+ *       chunk. Version 5 decryption takes the encrypted byte before each
+ *       chunk first. Version 5 encryption chunks are encrypted as if the
+ *       byte before them were 0, then XOR-ed with the real previous
+ *       encrypted byte.
+ * \sa honokamiku_pool_create()
+ * \sa honokamiku_pool_set_min_chunk()
+ */
+HMAPI void honokamiku_decrypt_block_parallel(
+	honokamiku_pool    *pool,
+	honokamiku_context *decrypter_context,
+	void               *buffer,
+	size_t              buffer_size
+);
+
+/*!
+ * \brief Get size of memory needed by keystream cache.
+ * \param slot_count Maximum amount of different keys cached
+ * \param stream_size Maximum amount of keystream bytes cached per key.
+ *                    Rounded up to multiple of 64KB
+ * \returns Memory size to pass to honokamiku_keycache_init(), or 0 if
+ *          \a slot_count is 0, \a stream_size is over 1GB, or the size
+ *          doesn't fit in `size_t`
+ */
+HMAPI size_t honokamiku_keycache_size(size_t slot_count, size_t stream_size);
+
+/*!
+ * \brief Create keystream cache in caller-provided memory.
+ *
+ * The memory can be a memory-mapped file shared between processes, so the
+ * keystream computed by one process is used by the others, and persists
+ * across runs. The cache only stores offsets, so it can be mapped at
+ * different addresses.
+ * \param memory Zero-filled memory, or memory of existing keystream cache with
+ *               same \a slot_count and \a stream_size. Must be aligned to 8
+ *               bytes and stay valid until honokamiku_keycache_free()
+ * \param memory_size Size of \a memory. At least
+ *                    honokamiku_keycache_size(slot_count, stream_size)
+ * \param slot_count Maximum amount of different keys cached
+ * \param stream_size Maximum amount of keystream bytes cached per key
+ * \returns Keystream cache, or NULL if arguments are invalid, \a memory holds
+ *          cache with different sizes, or out of memory. Free it with
+ *          honokamiku_keycache_free(), which doesn't free \a memory.
+ * \note Slots are claimed and filled with atomic operations, so the cache can
+ *       be used by multiple threads and processes at the same time.
+ * \warning A process which dies while extending keystream of a key leaves
+ *          that key locked: its cached keystream stays usable but never
+ *          grows, and bytes past it are decrypted with
+ *          honokamiku_decrypt_block(). A process which dies while claiming
+ *          a slot for a key leaves that key uncached. Zero the memory to
+ *          reset the cache when no process uses it.
+ */
+HMAPI honokamiku_keycache *honokamiku_keycache_init(
+	void   *memory,
+	size_t  memory_size,
+	size_t  slot_count,
+	size_t  stream_size
+);
+
+/*!
+ * \brief Create keystream cache in memory allocated by libhonoka.
+ * \param slot_count Maximum amount of different keys cached
+ * \param stream_size Maximum amount of keystream bytes cached per key
+ * \returns Keystream cache, or NULL if arguments are invalid or out of memory
+ * \sa honokamiku_keycache_init()
+ */
+HMAPI honokamiku_keycache *honokamiku_keycache_create(
+	size_t slot_count,
+	size_t stream_size
+);
+
+/*!
+ * \brief Free keystream cache.
+ * \param cache Keystream cache to free. Can be NULL.
+ */
+HMAPI void honokamiku_keycache_free(honokamiku_keycache *cache);
+
+/*!
+ * \brief Same as honokamiku_decrypt_block(), but XOR version 3 files with
+ *        keystream from \a cache.
+ *
+ * Keystream is computed when needed, in 64KB pages, and kept for other
+ * decrypter contexts with same keys. Bytes past the cached keystream, other
+ * decryption modes, and keys which don't fit in the cache anymore are
+ * decrypted with honokamiku_decrypt_block().
+ * \param cache Keystream cache. If it's NULL, this function is same as
+ *              honokamiku_decrypt_block()
+ * \param decrypter_context HonokaMiku decrypter context that already
+ *                          initialized with honokamiku_decrypt_init()
+ * \param buffer Buffer to be decrypted
+ * \param buffer_size Size of `buffer`
+ * \sa honokamiku_keycache_create()
+ */
+HMAPI void honokamiku_decrypt_block_cached(
+	honokamiku_keycache *cache,
+	honokamiku_context  *decrypter_context,
+	void                *buffer,
+	size_t               buffer_size
+);
+
 /******************************************************************************
 ** Useful macros                                                             **
 ******************************************************************************/
@@ -0,0 +1,228 @@
+/*!
+ * \file honokamiku_dispatch.c
+ * Runtime selection of multi-lane decryption kernels
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define HONOKAMIKU_DECRYPTER_CORE
+
+#include "honokamiku_decrypter.h"
+#include "honokamiku_internal.h"
+
+#if defined(LIBHONOKA_KERNEL_SSE2) || defined(LIBHONOKA_KERNEL_AVX2) || \
+    defined(LIBHONOKA_KERNEL_AVX512)
+#	define LIBHONOKA_X86_DISPATCH
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#	else
+#		include <cpuid.h>
+#	endif
+#endif
+
+#define LIBHONOKA_KERNELS(isa, cpu_features, stream_copy, md5_lanes, files_xor, files2_xor, files_lanes) \
+	{ \
+		#isa, \
+		cpu_features, \
+		libhonoka__v1_xor_##isa, \
+		libhonoka__v2_xor_##isa, \
+		libhonoka__lcg_xor_##isa, \
+		libhonoka__lcg2_xor_##isa, \
+		libhonoka__v5_decrypt_##isa, \
+		libhonoka__v5_encrypt_##isa, \
+		stream_copy, \
+		libhonoka__md5_##isa, \
+		md5_lanes, \
+		files_xor, \
+		files2_xor, \
+		files_lanes \
+	}
+
+#ifdef LIBHONOKA_KERNEL_AVX512
+static const libhonoka__kernels libhonoka__kernels_avx512 =
+	LIBHONOKA_KERNELS(avx512, LIBHONOKA_CPU_AVX512, libhonoka__stream_copy_sse2, 16, libhonoka__files_xor_avx512, libhonoka__files2_xor_avx512, 16);
+#endif
+
+#ifdef LIBHONOKA_KERNEL_AVX2
+static const libhonoka__kernels libhonoka__kernels_avx2 =
+	LIBHONOKA_KERNELS(avx2, LIBHONOKA_CPU_AVX2, libhonoka__stream_copy_sse2, 8, libhonoka__files_xor_avx2, libhonoka__files2_xor_avx2, 8);
+#endif
+
+#ifdef LIBHONOKA_KERNEL_SSE2
+static const libhonoka__kernels libhonoka__kernels_sse2 =
+	LIBHONOKA_KERNELS(sse2, LIBHONOKA_CPU_SSE2, libhonoka__stream_copy_sse2, 4, NULL, NULL, 0);
+#endif
+
+#ifdef LIBHONOKA_KERNEL_NEON
+static const libhonoka__kernels libhonoka__kernels_neon =
+	LIBHONOKA_KERNELS(neon, 0, NULL, 4, NULL, NULL, 0);
+#endif
+
+static const libhonoka__kernels libhonoka__kernels_scalar = {
+	"scalar", 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL, 0
+};
+
+/* Fastest first */
+static const libhonoka__kernels *const libhonoka__kernel_list[] = {
+#ifdef LIBHONOKA_KERNEL_AVX512
+	&libhonoka__kernels_avx512,
+#endif
+#ifdef LIBHONOKA_KERNEL_AVX2
+	&libhonoka__kernels_avx2,
+#endif
+#ifdef LIBHONOKA_KERNEL_SSE2
+	&libhonoka__kernels_sse2,
+#endif
+#ifdef LIBHONOKA_KERNEL_NEON
+	&libhonoka__kernels_neon,
+#endif
+	&libhonoka__kernels_scalar
+};
+
+/* Index of selected kernels in libhonoka__kernel_list plus 1, 0 if not */
+/* selected yet. Worker threads read it, so it's accessed atomically */
+static volatile unsigned int libhonoka__kernels_active = 0;
+
+#ifdef LIBHONOKA_X86_DISPATCH
+static void libhonoka__cpuid(unsigned int leaf, unsigned int *regs)
+{
+#ifdef _MSC_VER
+	int r[4];
+
+	__cpuidex(r, (int) leaf, 0);
+	regs[0] = r[0];
+	regs[1] = r[1];
+	regs[2] = r[2];
+	regs[3] = r[3];
+#else
+	__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned int libhonoka__xgetbv()
+{
+#ifdef _MSC_VER
+	return (unsigned int) _xgetbv(0);
+#else
+	unsigned int eax, edx;
+
+	__asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+	return eax;
+#endif
+}
+#endif /* LIBHONOKA_X86_DISPATCH */
+
+/*!
+ * Get LIBHONOKA_CPU_* features supported by the CPU and the OS.
+ */
+static unsigned int libhonoka__cpu_features()
+{
+	unsigned int features = 0;
+#ifdef LIBHONOKA_X86_DISPATCH
+	unsigned int regs[4]; /* EAX, EBX, ECX, EDX */
+	unsigned int max_leaf, xcr0;
+
+	libhonoka__cpuid(0, regs);
+	max_leaf = regs[0];
+	if (max_leaf < 1) return 0;
+
+	libhonoka__cpuid(1, regs);
+	if (regs[3] & (1U << 26))
+		features |= LIBHONOKA_CPU_SSE2;
+
+	/* AVX registers must be saved by the OS (OSXSAVE and XCR0) */
+	if ((regs[2] & (1U << 27)) == 0 || max_leaf < 7)
+		return features;
+
+	xcr0 = libhonoka__xgetbv();
+	libhonoka__cpuid(7, regs);
+
+	/* XMM and YMM state */
+	if ((xcr0 & 6) == 6 && (regs[1] & (1U << 5)))
+		features |= LIBHONOKA_CPU_AVX2;
+	/* Plus opmask and ZMM state, AVX512F and AVX512BW */
+	if ((xcr0 & 230) == 230 && (regs[1] & (1U << 16)) && (regs[1] & (1U << 30)))
+		features |= LIBHONOKA_CPU_AVX512;
+#endif
+
+	return features;
+}
+
+static unsigned int libhonoka__select_kernels()
+{
+	const char *name = getenv("HONOKAMIKU_KERNEL");
+	unsigned int features = libhonoka__cpu_features();
+	unsigned int i;
+
+	/* Forced kernels, if the CPU supports them */
+	if (name != NULL)
+		for (i = 0; i < sizeof(libhonoka__kernel_list) / sizeof(libhonoka__kernel_list[0]); i++)
+		{
+			const libhonoka__kernels *kernels = libhonoka__kernel_list[i];
+
+			if (strcmp(kernels->name, name) == 0 &&
+			    (kernels->cpu_features & features) == kernels->cpu_features)
+				return i;
+		}
+
+	for (i = 0; ; i++)
+	{
+		const libhonoka__kernels *kernels = libhonoka__kernel_list[i];
+
+#ifdef LIBHONOKA_KERNEL_NEON
+		/* Not verified on real AArch64 hardware yet, so only used when */
+		/* forced with HONOKAMIKU_KERNEL=neon */
+		if (kernels == &libhonoka__kernels_neon)
+			continue;
+#endif
+
+		/* Scalar is the last one and always supported */
+		if ((kernels->cpu_features & features) == kernels->cpu_features)
+			return i;
+	}
+}
+
+const libhonoka__kernels *libhonoka__get_kernels()
+{
+	unsigned int active = libhonoka__load(&libhonoka__kernels_active);
+
+	/* Threads racing here select the same kernels */
+	if (active == 0)
+	{
+		active = libhonoka__select_kernels() + 1;
+		libhonoka__store(&libhonoka__kernels_active, active);
+	}
+
+	return libhonoka__kernel_list[active - 1];
+}
+
+const libhonoka__kernels *libhonoka__get_md5_kernels(size_t count)
+{
+	const libhonoka__kernels *active = libhonoka__get_kernels();
+	const libhonoka__kernels *kernels = active;
+	size_t i = 0;
+
+	if (active->md5 == NULL || active->md5_lanes <= count)
+		return active;
+
+	/* Kernels after the selected ones need a subset of its CPU features */
+	while (libhonoka__kernel_list[i] != active)
+		i++;
+
+	for (i++; i < sizeof(libhonoka__kernel_list) / sizeof(libhonoka__kernel_list[0]); i++)
+		if (libhonoka__kernel_list[i]->md5 != NULL)
+		{
+			if (libhonoka__kernel_list[i]->md5_lanes < count)
+				break;
+
+			kernels = libhonoka__kernel_list[i];
+		}
+
+	return kernels;
+}
+
+const char *honokamiku_kernel_name()
+{
+	return libhonoka__get_kernels()->name;
+}
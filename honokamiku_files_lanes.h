@@ -0,0 +1,196 @@
+/*!
+ * \file honokamiku_files_lanes.h
+ * Multi-lane file decryption, decrypting one version 3, 4 or 6 file per
+ * 128 bits of the registers.
+ *
+ * Included by the kernel files after defining the vector operations:
+ * - `LIBHONOKA_FILES_VEC`: vector type of 32-bit lanes
+ * - `LIBHONOKA_FILES_PARTS`: amount of 128 bits in `LIBHONOKA_FILES_VEC`
+ * - `LIBHONOKA_FILES_LOAD(p)` and `LIBHONOKA_FILES_STORE(p, x)`: unaligned
+ *   load and store
+ * - `LIBHONOKA_FILES_SET1(x)`: broadcast 32-bit value
+ * - `LIBHONOKA_FILES_ADD`, `LIBHONOKA_FILES_MUL`, `LIBHONOKA_FILES_AND`,
+ *   `LIBHONOKA_FILES_XOR`: lane-wise operations, `LIBHONOKA_FILES_MUL`
+ *   keeping the low 32 bits
+ * - `LIBHONOKA_FILES_SHIFT(p)`: load shift values of each 128 bits, as
+ *   taken by `LIBHONOKA_FILES_SRL`
+ * - `LIBHONOKA_FILES_SRL(x, n)`: shift lanes right by `n`
+ * - `LIBHONOKA_FILES_PACKS32` and `LIBHONOKA_FILES_PACKUS16`: pack each
+ *   128 bits with signed and unsigned saturation
+ * - `LIBHONOKA_FILES_PART(x, k)`: 128 bits `k` of `x` as `__m128i`, `k`
+ *   being a constant
+ * - `LIBHONOKA_FILES_FUNC`: name of the kernel function
+ * - `LIBHONOKA_FILES_SECOND`: defined if the files have 2 LCGs, as version
+ *   6 does
+ *
+ * `LIBHONOKA_FILES_FUNC` and `LIBHONOKA_FILES_SECOND` are undefined at the
+ * end, so the file can be included again for the other kernel.
+ */
+
+/* Files in a register */
+#define LIBHONOKA_FILES_P LIBHONOKA_FILES_PARTS
+/* Jump parameters `j` of the files of register group `g` */
+#define LIBHONOKA_FILES_MUL_VAL(g, j) \
+	LIBHONOKA_FILES_LOAD(files->mul_val[j][g * LIBHONOKA_FILES_P])
+#define LIBHONOKA_FILES_ADD_VAL(g, j) \
+	LIBHONOKA_FILES_LOAD(files->add_val[j][g * LIBHONOKA_FILES_P])
+#define LIBHONOKA_FILES_MUL_VAL2(g, j) \
+	LIBHONOKA_FILES_LOAD(files->mul_val2[j][g * LIBHONOKA_FILES_P])
+#define LIBHONOKA_FILES_ADD_VAL2(g, j) \
+	LIBHONOKA_FILES_LOAD(files->add_val2[j][g * LIBHONOKA_FILES_P])
+/* Keys `s` of group `g`, `4 * (j + 1)` steps later */
+#define LIBHONOKA_FILES_JUMP(s, g, j) LIBHONOKA_FILES_ADD( \
+	LIBHONOKA_FILES_MUL(s, LIBHONOKA_FILES_MUL_VAL(g, j)), LIBHONOKA_FILES_ADD_VAL(g, j))
+#define LIBHONOKA_FILES_JUMP2(t, g, j) LIBHONOKA_FILES_ADD( \
+	LIBHONOKA_FILES_MUL(t, LIBHONOKA_FILES_MUL_VAL2(g, j)), LIBHONOKA_FILES_ADD_VAL2(g, j))
+
+#ifdef LIBHONOKA_FILES_SECOND
+/* Keystream bytes of keys `s` and `t` of group `g` */
+#	define LIBHONOKA_FILES_KEY(s, t, g) LIBHONOKA_FILES_AND(LIBHONOKA_FILES_XOR( \
+		LIBHONOKA_FILES_SRL(s, sshift##g), LIBHONOKA_FILES_SRL(t, tshift##g)), mask)
+/* Keystream bytes `4 * (j + 1)` steps after the keys of group `g` */
+#	define LIBHONOKA_FILES_STEP_KEY(g, j) LIBHONOKA_FILES_KEY( \
+		LIBHONOKA_FILES_JUMP(s##g, g, j), LIBHONOKA_FILES_JUMP2(t##g, g, j), g)
+/* Advance keys of group `g` by 16 steps */
+#	define LIBHONOKA_FILES_NEXT(g) \
+		s##g = LIBHONOKA_FILES_JUMP(s##g, g, 3); \
+		t##g = LIBHONOKA_FILES_JUMP2(t##g, g, 3);
+#else
+#	define LIBHONOKA_FILES_KEY(s, t, g) \
+		LIBHONOKA_FILES_AND(LIBHONOKA_FILES_SRL(s, sshift##g), mask)
+#	define LIBHONOKA_FILES_STEP_KEY(g, j) \
+		LIBHONOKA_FILES_KEY(LIBHONOKA_FILES_JUMP(s##g, g, j), 0, g)
+#	define LIBHONOKA_FILES_NEXT(g) \
+		s##g = LIBHONOKA_FILES_JUMP(s##g, g, 3);
+#endif
+
+#ifdef LIBHONOKA_FILES_SECOND
+#	define LIBHONOKA_FILES_TAIL_KEYS2(g, f) \
+		_mm_storeu_si128((__m128i *) files->tail_keys2[g * LIBHONOKA_FILES_P + f], LIBHONOKA_FILES_PART(t##g, f));
+#else
+#	define LIBHONOKA_FILES_TAIL_KEYS2(g, f)
+#endif
+
+/* XOR 16 bytes of file `f` of group `g`. The keystream and keys of the */
+/* incomplete block after the last block go to `tail` and `tail_keys` */
+#define LIBHONOKA_FILES_XOR16(g, f) \
+	if (full || i < blocks[g * LIBHONOKA_FILES_P + f]) \
+	{ \
+		__m128i *p = (__m128i *) (buffers[g * LIBHONOKA_FILES_P + f] + (i << 4)); \
+		_mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), LIBHONOKA_FILES_PART(k, f))); \
+	} \
+	else if (i == blocks[g * LIBHONOKA_FILES_P + f]) \
+	{ \
+		_mm_storeu_si128((__m128i *) files->tail[g * LIBHONOKA_FILES_P + f], LIBHONOKA_FILES_PART(k, f)); \
+		_mm_storeu_si128((__m128i *) files->tail_keys[g * LIBHONOKA_FILES_P + f], LIBHONOKA_FILES_PART(s##g, f)); \
+		LIBHONOKA_FILES_TAIL_KEYS2(g, f) \
+	}
+
+#if LIBHONOKA_FILES_P == 1
+#	define LIBHONOKA_FILES_XOR_GROUP(g) LIBHONOKA_FILES_XOR16(g, 0)
+#elif LIBHONOKA_FILES_P == 2
+#	define LIBHONOKA_FILES_XOR_GROUP(g) \
+		LIBHONOKA_FILES_XOR16(g, 0) LIBHONOKA_FILES_XOR16(g, 1)
+#else
+#	define LIBHONOKA_FILES_XOR_GROUP(g) \
+		LIBHONOKA_FILES_XOR16(g, 0) LIBHONOKA_FILES_XOR16(g, 1) \
+		LIBHONOKA_FILES_XOR16(g, 2) LIBHONOKA_FILES_XOR16(g, 3)
+#endif
+
+/* Decrypt a block of the files of group `g`, with 16 keystream bytes of */
+/* each file in order, then advance to the next block. The keys of the 4 */
+/* words are all computed from the current keys, so the multiplications */
+/* don't wait for each other */
+#define LIBHONOKA_FILES_BLOCK(g) \
+	k = LIBHONOKA_FILES_PACKUS16( \
+		LIBHONOKA_FILES_PACKS32(LIBHONOKA_FILES_KEY(s##g, t##g, g), LIBHONOKA_FILES_STEP_KEY(g, 0)), \
+		LIBHONOKA_FILES_PACKS32(LIBHONOKA_FILES_STEP_KEY(g, 1), LIBHONOKA_FILES_STEP_KEY(g, 2)) \
+	); \
+	LIBHONOKA_FILES_XOR_GROUP(g) \
+	LIBHONOKA_FILES_NEXT(g)
+
+/*!
+ * XOR `steps` blocks of 16 bytes of `4 * LIBHONOKA_FILES_PARTS` files, see
+ * libhonoka__files_kernel.
+ */
+void LIBHONOKA_FILES_FUNC(
+	libhonoka__files     *files,
+	unsigned char *const *buffers,
+	const size_t         *blocks,
+	size_t                steps
+)
+{
+	/* Registers of group `g` hold the files from `g * LIBHONOKA_FILES_P` */
+	const LIBHONOKA_FILES_VEC mask = LIBHONOKA_FILES_SET1(255);
+	const LIBHONOKA_FILES_VEC sshift0 = LIBHONOKA_FILES_SHIFT(files->shift_val[0]);
+	const LIBHONOKA_FILES_VEC sshift1 = LIBHONOKA_FILES_SHIFT(files->shift_val[LIBHONOKA_FILES_P]);
+	const LIBHONOKA_FILES_VEC sshift2 = LIBHONOKA_FILES_SHIFT(files->shift_val[2 * LIBHONOKA_FILES_P]);
+	const LIBHONOKA_FILES_VEC sshift3 = LIBHONOKA_FILES_SHIFT(files->shift_val[3 * LIBHONOKA_FILES_P]);
+	LIBHONOKA_FILES_VEC s0 = LIBHONOKA_FILES_LOAD(files->keys[0]);
+	LIBHONOKA_FILES_VEC s1 = LIBHONOKA_FILES_LOAD(files->keys[LIBHONOKA_FILES_P]);
+	LIBHONOKA_FILES_VEC s2 = LIBHONOKA_FILES_LOAD(files->keys[2 * LIBHONOKA_FILES_P]);
+	LIBHONOKA_FILES_VEC s3 = LIBHONOKA_FILES_LOAD(files->keys[3 * LIBHONOKA_FILES_P]);
+#ifdef LIBHONOKA_FILES_SECOND
+	const LIBHONOKA_FILES_VEC tshift0 = LIBHONOKA_FILES_SHIFT(files->shift_val2[0]);
+	const LIBHONOKA_FILES_VEC tshift1 = LIBHONOKA_FILES_SHIFT(files->shift_val2[LIBHONOKA_FILES_P]);
+	const LIBHONOKA_FILES_VEC tshift2 = LIBHONOKA_FILES_SHIFT(files->shift_val2[2 * LIBHONOKA_FILES_P]);
+	const LIBHONOKA_FILES_VEC tshift3 = LIBHONOKA_FILES_SHIFT(files->shift_val2[3 * LIBHONOKA_FILES_P]);
+	LIBHONOKA_FILES_VEC t0 = LIBHONOKA_FILES_LOAD(files->keys2[0]);
+	LIBHONOKA_FILES_VEC t1 = LIBHONOKA_FILES_LOAD(files->keys2[LIBHONOKA_FILES_P]);
+	LIBHONOKA_FILES_VEC t2 = LIBHONOKA_FILES_LOAD(files->keys2[2 * LIBHONOKA_FILES_P]);
+	LIBHONOKA_FILES_VEC t3 = LIBHONOKA_FILES_LOAD(files->keys2[3 * LIBHONOKA_FILES_P]);
+#endif
+	/* Files ending in this call don't store past their end */
+	int full = 1;
+	size_t i;
+
+	for (i = 0; i < 4 * LIBHONOKA_FILES_P; i++)
+	{
+		size_t j;
+
+		full &= blocks[i] >= steps;
+
+		/* So many files at once are more streams than hardware prefetchers */
+		/* follow. Fetch the blocks of the next call */
+		for (j = 0; j < steps << 4; j += 64)
+			_mm_prefetch((const char *) buffers[i] + (steps << 4) + j, _MM_HINT_T0);
+	}
+
+	for (i = 0; i < steps; i++)
+	{
+		LIBHONOKA_FILES_VEC k;
+
+		LIBHONOKA_FILES_BLOCK(0)
+		LIBHONOKA_FILES_BLOCK(1)
+		LIBHONOKA_FILES_BLOCK(2)
+		LIBHONOKA_FILES_BLOCK(3)
+	}
+
+	LIBHONOKA_FILES_STORE(files->keys[0], s0);
+	LIBHONOKA_FILES_STORE(files->keys[LIBHONOKA_FILES_P], s1);
+	LIBHONOKA_FILES_STORE(files->keys[2 * LIBHONOKA_FILES_P], s2);
+	LIBHONOKA_FILES_STORE(files->keys[3 * LIBHONOKA_FILES_P], s3);
+#ifdef LIBHONOKA_FILES_SECOND
+	LIBHONOKA_FILES_STORE(files->keys2[0], t0);
+	LIBHONOKA_FILES_STORE(files->keys2[LIBHONOKA_FILES_P], t1);
+	LIBHONOKA_FILES_STORE(files->keys2[2 * LIBHONOKA_FILES_P], t2);
+	LIBHONOKA_FILES_STORE(files->keys2[3 * LIBHONOKA_FILES_P], t3);
+#endif
+}
+
+#undef LIBHONOKA_FILES_P
+#undef LIBHONOKA_FILES_MUL_VAL
+#undef LIBHONOKA_FILES_ADD_VAL
+#undef LIBHONOKA_FILES_MUL_VAL2
+#undef LIBHONOKA_FILES_ADD_VAL2
+#undef LIBHONOKA_FILES_JUMP
+#undef LIBHONOKA_FILES_JUMP2
+#undef LIBHONOKA_FILES_KEY
+#undef LIBHONOKA_FILES_STEP_KEY
+#undef LIBHONOKA_FILES_NEXT
+#undef LIBHONOKA_FILES_TAIL_KEYS2
+#undef LIBHONOKA_FILES_XOR16
+#undef LIBHONOKA_FILES_XOR_GROUP
+#undef LIBHONOKA_FILES_BLOCK
+#undef LIBHONOKA_FILES_FUNC
+#undef LIBHONOKA_FILES_SECOND
@@ -0,0 +1,397 @@
+/*!
+ * \file honokamiku_internal.h
+ * Internal declarations shared between libhonoka source files
+ */
+
+#ifndef __DEP_HONOKAMIKU_INTERNAL_H
+#define __DEP_HONOKAMIKU_INTERNAL_H
+
+#include <stdlib.h>
+
+#include "honokamiku_config.h"
+
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || \
+    defined(_M_X64)
+#	define LIBHONOKA_X86
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define LIBHONOKA_X86_SSE2
+#endif
+
+/*
+ * Atomic operations on `volatile unsigned int`, all with full barriers.
+ * Without compiler support, libhonoka must be used by one thread only.
+ */
+#if defined(_MSC_VER)
+#	include <intrin.h>
+#	define libhonoka__cas(p, o, n) \
+		(_InterlockedCompareExchange((volatile long *) (p), (long) (n), (long) (o)) == (long) (o))
+#	define libhonoka__load(p) \
+		((unsigned int) _InterlockedCompareExchange((volatile long *) (p), 0, 0))
+#	define libhonoka__store(p, v) \
+		_InterlockedExchange((volatile long *) (p), (long) (v))
+#elif defined(__GNUC__)
+#	define libhonoka__cas(p, o, n) __sync_bool_compare_and_swap((p), (o), (n))
+#	define libhonoka__load(p) __sync_val_compare_and_swap((p), 0, 0)
+#	define libhonoka__store(p, v) \
+		do { \
+			unsigned int libhonoka__old; \
+			do libhonoka__old = libhonoka__load(p); \
+			while (!__sync_bool_compare_and_swap((p), libhonoka__old, (v))); \
+		} while (0)
+#else
+#	define libhonoka__cas(p, o, n) (*(p) == (o) ? (*(p) = (n), 1) : 0)
+#	define libhonoka__load(p) (*(p))
+#	define libhonoka__store(p, v) (*(p) = (v))
+#endif
+
+/*!
+ * Minimum buffer size before multi-lane kernels are used. Smaller buffers
+ * are not worth computing the lane keys for.
+ */
+#define LIBHONOKA_KERNEL_MIN 128
+
+/*!
+ * Minimum buffer size before honokamiku_decrypt_copy() bypasses the cache
+ * when storing. Smaller buffers likely fit in the cache and get read soon.
+ */
+#define LIBHONOKA_STREAM_MIN 4194304
+
+/*!
+ * Blocks of 16 bytes decrypted in each lane per call of the file kernels.
+ * Lanes whose file ends in the middle idle for the rest of the step.
+ */
+#define LIBHONOKA_FILES_STEP 16
+
+/*!
+ * Most lanes of the file kernels.
+ */
+#define LIBHONOKA_FILES_MAX_LANES 16
+
+/*!
+ * LCG parameters, as used by version 3 and later.
+ */
+typedef struct libhonoka__lcg
+{
+	unsigned int mul_val;   /*!< LCG multiply value */
+	unsigned int add_val;   /*!< LCG increment value */
+	unsigned int shift_val; /*!< LCG shift value */
+} libhonoka__lcg;
+
+/*!
+ * XOR bytes of `in` with version 1 keys into `out`, 4 bytes per key, most
+ * significant byte first, starting from `*key` at position multiple of 4.
+ * The key is incremented by `update_key` every 4 bytes. Only whole blocks
+ * are processed, and `*key` is updated past them. Returns the amount of
+ * bytes processed.
+ */
+typedef size_t (*libhonoka__v1_kernel)(
+	unsigned int        *key,
+	unsigned int         update_key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+);
+
+/*!
+ * XOR bytes of `in` with version 2 keys into `out`, 2 bytes per key, starting
+ * from `*key` at even position. Only whole blocks are processed, and `*key`
+ * is updated past them. Returns the amount of bytes processed, which is 0 if
+ * `*key` isn't the result of honokamiku_update_v2 (only possible for the
+ * initial key).
+ */
+typedef size_t (*libhonoka__v2_kernel)(
+	unsigned int        *key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+);
+
+/*!
+ * XOR bytes of `in` with `(key >> shift_val)` of consecutive LCG keys into
+ * `out`, starting from `*key`. `in` and `out` may be the same buffer.
+ * Only whole blocks are processed, and `*key` is updated past them.
+ * Returns the amount of bytes processed.
+ */
+typedef size_t (*libhonoka__lcg_kernel)(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+);
+
+/*!
+ * Same as libhonoka__lcg_kernel, but XOR with
+ * `(key >> shift_val) ^ (key2 >> shift_val2)` of 2 LCGs, as version 6 does.
+ */
+typedef size_t (*libhonoka__lcg2_kernel)(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned int         *key2,
+	const libhonoka__lcg *lcg2,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+);
+
+/*!
+ * Version 5 kernel. Decryption is `out[i] = in[i] ^ (key >> shift_val) ^
+ * in[i - 1]` and encryption is `out[i] = in[i] ^ (key >> shift_val) ^
+ * out[i - 1]`, where `*chain` is the encrypted byte before `in`/`out`.
+ * `*chain` is updated to the last encrypted byte processed.
+ */
+typedef size_t (*libhonoka__v5_kernel)(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+);
+
+/*!
+ * Copy `size` bytes of `in` into `out` with non-temporal stores, so `out`
+ * doesn't evict other data from the cache.
+ */
+typedef void (*libhonoka__copy_kernel)(
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+);
+
+/*!
+ * State of the files decrypted by the file kernels, one file per lane.
+ * `keys[i]` are 4 consecutive keys of the file in lane `i`, and
+ * `mul_val[j]` and `add_val[j]` advance keys by `4 * (j + 1)` steps, so
+ * that the 16 keys of a block are computed at once. Values of a lane are
+ * repeated 4 times, one for each key. The second LCG is only used by
+ * version 6 files.
+ */
+typedef struct libhonoka__files
+{
+	unsigned int keys[LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int mul_val[4][LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int add_val[4][LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int shift_val[LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int keys2[LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int mul_val2[4][LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int add_val2[4][LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int shift_val2[LIBHONOKA_FILES_MAX_LANES][4];
+	/*! Keystream of the incomplete block after the last block of a file */
+	unsigned char tail[LIBHONOKA_FILES_MAX_LANES][16];
+	/*! Keys of the incomplete block, as `keys` and `keys2` */
+	unsigned int tail_keys[LIBHONOKA_FILES_MAX_LANES][4];
+	unsigned int tail_keys2[LIBHONOKA_FILES_MAX_LANES][4];
+} libhonoka__files;
+
+/*!
+ * XOR `steps` blocks of 16 bytes of one file per lane with `key >>
+ * shift_val` of the file in `files`, or `(key >> shift_val) ^ (key2 >>
+ * shift_val2)` for the version 6 kernel. `buffers[i]` is decrypted in
+ * place, but only its first `blocks[i]` blocks. The keystream and keys of
+ * block `blocks[i]` go to `tail[i]` and `tail_keys[i]` of `files`. The
+ * keys of every lane are updated past the `steps` blocks.
+ */
+typedef void (*libhonoka__files_kernel)(
+	libhonoka__files     *files,
+	unsigned char *const *buffers,
+	const size_t         *blocks,
+	size_t                steps
+);
+
+/*!
+ * Hash blocks of one MD5 message per lane, see honokamiku_md5_lanes.h.
+ */
+typedef void (*libhonoka__md5_kernel)(
+	const unsigned int *words,
+	const unsigned int *block_counts,
+	size_t              block_max,
+	unsigned int       *state
+);
+
+/*!
+ * Declare kernels of specific instruction set.
+ */
+#define LIBHONOKA_DECLARE_KERNELS(isa) \
+	size_t libhonoka__v1_xor_##isa( \
+		unsigned int *key, unsigned int update_key, \
+		const unsigned char *in, unsigned char *out, size_t size \
+	); \
+	size_t libhonoka__v2_xor_##isa( \
+		unsigned int *key, \
+		const unsigned char *in, unsigned char *out, size_t size \
+	); \
+	size_t libhonoka__lcg_xor_##isa( \
+		unsigned int *key, const libhonoka__lcg *lcg, \
+		const unsigned char *in, unsigned char *out, size_t size \
+	); \
+	size_t libhonoka__lcg2_xor_##isa( \
+		unsigned int *key, const libhonoka__lcg *lcg, \
+		unsigned int *key2, const libhonoka__lcg *lcg2, \
+		const unsigned char *in, unsigned char *out, size_t size \
+	); \
+	size_t libhonoka__v5_decrypt_##isa( \
+		unsigned int *key, const libhonoka__lcg *lcg, unsigned char *chain, \
+		const unsigned char *in, unsigned char *out, size_t size \
+	); \
+	size_t libhonoka__v5_encrypt_##isa( \
+		unsigned int *key, const libhonoka__lcg *lcg, unsigned char *chain, \
+		const unsigned char *in, unsigned char *out, size_t size \
+	); \
+	void libhonoka__md5_##isa( \
+		const unsigned int *words, const unsigned int *block_counts, \
+		size_t block_max, unsigned int *state \
+	);
+
+/*!
+ * Declare file kernels of specific instruction set.
+ */
+#define LIBHONOKA_DECLARE_FILES_KERNELS(isa) \
+	void libhonoka__files_xor_##isa( \
+		libhonoka__files *files, unsigned char *const *buffers, \
+		const size_t *blocks, size_t steps \
+	); \
+	void libhonoka__files2_xor_##isa( \
+		libhonoka__files *files, unsigned char *const *buffers, \
+		const size_t *blocks, size_t steps \
+	);
+
+/* Kernels compiled with their instruction set, see CMakeLists.txt. The */
+/* checks there see the host processor, which isn't always the target */
+#if defined(LIBHONOKA_X86) && \
+    (defined(HONOKAMIKU_HAVE_SSE2) || defined(LIBHONOKA_X86_SSE2))
+#	define LIBHONOKA_KERNEL_SSE2
+LIBHONOKA_DECLARE_KERNELS(sse2)
+void libhonoka__stream_copy_sse2(const unsigned char *in, unsigned char *out, size_t size);
+#endif
+
+#if defined(LIBHONOKA_X86) && \
+    (defined(HONOKAMIKU_HAVE_AVX2) || defined(__AVX2__))
+#	define LIBHONOKA_KERNEL_AVX2
+LIBHONOKA_DECLARE_KERNELS(avx2)
+LIBHONOKA_DECLARE_FILES_KERNELS(avx2)
+#endif
+
+#if defined(LIBHONOKA_X86) && (defined(HONOKAMIKU_HAVE_AVX512) || \
+    (defined(__AVX512F__) && defined(__AVX512BW__)))
+#	define LIBHONOKA_KERNEL_AVX512
+LIBHONOKA_DECLARE_KERNELS(avx512)
+LIBHONOKA_DECLARE_FILES_KERNELS(avx512)
+#endif
+
+/* AArch64 always has NEON. The kernels assume little endian */
+#if (defined(__aarch64__) || defined(_M_ARM64)) && !defined(__AARCH64EB__)
+#	define LIBHONOKA_KERNEL_NEON
+LIBHONOKA_DECLARE_KERNELS(neon)
+#endif
+
+/*!
+ * Set of kernels of an instruction set. NULL kernels are not available and
+ * the scalar code is used instead.
+ */
+typedef struct libhonoka__kernels
+{
+	const char             *name;         /*!< Instruction set name */
+	unsigned int            cpu_features; /*!< Required LIBHONOKA_CPU_* */
+	libhonoka__v1_kernel    v1_xor;
+	libhonoka__v2_kernel    v2_xor;
+	libhonoka__lcg_kernel   lcg_xor;
+	libhonoka__lcg2_kernel  lcg2_xor;
+	libhonoka__v5_kernel    v5_decrypt;
+	libhonoka__v5_kernel    v5_encrypt;
+	libhonoka__copy_kernel  stream_copy;
+	libhonoka__md5_kernel   md5;
+	size_t                  md5_lanes;    /*!< Messages hashed by `md5` */
+	libhonoka__files_kernel files_xor;
+	libhonoka__files_kernel files2_xor;   /*!< Version 6 `files_xor` */
+	size_t                  files_lanes;  /*!< Files decrypted by `files_xor` */
+} libhonoka__kernels;
+
+#define LIBHONOKA_CPU_SSE2   1
+#define LIBHONOKA_CPU_AVX2   2
+#define LIBHONOKA_CPU_AVX512 4 /* AVX512F and AVX512BW */
+
+/*!
+ * Get the fastest kernels the CPU supports, unless overridden by the
+ * `HONOKAMIKU_KERNEL` environment variable. Detected once.
+ */
+const libhonoka__kernels *libhonoka__get_kernels();
+
+/*!
+ * Get the kernels with the fewest MD5 lanes, down to `count`, out of the
+ * selected kernels and the slower ones. Hashing few messages with wide
+ * kernels wastes most of the lanes.
+ */
+const libhonoka__kernels *libhonoka__get_md5_kernels(size_t count);
+
+/*!
+ * Compute the lane keys of a multi-lane kernel: `lanes[i]` is the key `i`
+ * steps after `key`. Also computes the LCG parameters which advance a key
+ * by `count` steps at once. Used by the kernels.
+ */
+void libhonoka__lcg_lanes(
+	unsigned int          key,
+	const libhonoka__lcg *lcg,
+	unsigned int         *lanes,
+	size_t                count,
+	unsigned int         *mul_val,
+	unsigned int         *add_val
+);
+
+/*!
+ * Compute the lane keys of a multi-lane version 2 kernel: `lanes[i]` is the
+ * fully reduced key `i - 1` steps after `key`, so honokamiku_update_v2 of
+ * `lanes[i]` is the key `i` steps after `key`. Also computes 16807^`count`
+ * modulo 2^31 - 1 which advances the lanes by `count` steps. Returns 0 if
+ * `key` isn't the result of honokamiku_update_v2. Used by the kernels.
+ */
+int libhonoka__v2_lanes(
+	unsigned int  key,
+	unsigned int *lanes,
+	size_t        count,
+	unsigned int *mul_val
+);
+
+/*!
+ * MD5 message of 2 parts, as used by the decrypter initialization.
+ */
+typedef struct libhonoka__md5_message
+{
+	const char *prefix;
+	size_t      prefix_size;
+	const char *name;
+	size_t      name_size;
+} libhonoka__md5_message;
+
+/*!
+ * Compute MD5 digests of `count` messages into `digests`, 16 bytes each,
+ * hashing multiple messages at once with the kernels.
+ */
+void libhonoka__md5_many(
+	const libhonoka__md5_message *messages,
+	size_t                        count,
+	unsigned char                *digests
+);
+
+struct honokamiku_pool;
+
+/*!
+ * Task of a worker thread pool, called with the task index.
+ */
+typedef void (*libhonoka__pool_task)(void *arg, size_t index);
+
+/*!
+ * Run `task` with indices 0 up to `count` on the pool threads, including the
+ * calling thread, and wait until all of them finish.
+ */
+void libhonoka__pool_run(
+	struct honokamiku_pool *pool,
+	libhonoka__pool_task    task,
+	void                   *arg,
+	size_t                  count
+);
+
+#endif /* __DEP_HONOKAMIKU_INTERNAL_H */
@@ -0,0 +1,467 @@
+/*!
+ * \file honokamiku_kernel_avx2.c
+ * AVX2 multi-lane decryption kernels
+ */
+
+#include "honokamiku_internal.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+/*!
+ * Load 2 groups of 4 lanes into the low and high half of a register.
+ */
+static __m256i libhonoka__load2x4_avx2(const unsigned int *lo, const unsigned int *hi)
+{
+	return _mm256_inserti128_si256(
+		_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) lo)),
+		_mm_loadu_si128((const __m128i *) hi),
+		1
+	);
+}
+
+/*!
+ * Extract the keystream byte of 4 registers of 8 LCG lanes. Lanes are laid
+ * out so that the in-lane packs yield the bytes in order.
+ */
+static __m256i libhonoka__pack4_avx2(
+	__m256i s0, __m256i s1, __m256i s2, __m256i s3,
+	__m128i shift, __m256i mask
+)
+{
+	return _mm256_packus_epi16(
+		_mm256_packs_epi32(
+			_mm256_and_si256(_mm256_srl_epi32(s0, shift), mask),
+			_mm256_and_si256(_mm256_srl_epi32(s1, shift), mask)
+		),
+		_mm256_packs_epi32(
+			_mm256_and_si256(_mm256_srl_epi32(s2, shift), mask),
+			_mm256_and_si256(_mm256_srl_epi32(s3, shift), mask)
+		)
+	);
+}
+
+size_t libhonoka__v1_xor_avx2(
+	unsigned int        *key,
+	unsigned int         update_key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 8 keys, 4 bytes each */
+	__m256i k, step, bswap;
+	size_t blocks = size >> 5, i;
+
+	if (blocks == 0)
+		return 0;
+
+	k = _mm256_add_epi32(
+		_mm256_set1_epi32((int) *key),
+		_mm256_mullo_epi32(
+			_mm256_set1_epi32((int) update_key),
+			_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)
+		)
+	);
+	step = _mm256_set1_epi32((int) (update_key * 8));
+	bswap = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+	);
+
+	for (i = 0; i < blocks; i++, in += 32, out += 32)
+	{
+		_mm256_storeu_si256((__m256i *) out, _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *) in),
+			_mm256_shuffle_epi8(k, bswap)
+		));
+		k = _mm256_add_epi32(k, step);
+	}
+
+	*key += (unsigned int) (blocks << 3) * update_key;
+	return blocks << 5;
+}
+
+/*!
+ * Multiply each 16-bit lane value (upper 16 bits must be 0) by 16807.
+ */
+static __m256i libhonoka__mul16807_avx2(__m256i x)
+{
+	const __m256i k = _mm256_set1_epi32(16807);
+
+	return _mm256_or_si256(
+		_mm256_mullo_epi16(x, k),
+		_mm256_slli_epi32(_mm256_mulhi_epu16(x, k), 16)
+	);
+}
+
+/*!
+ * Branch-free honokamiku_update_v2 of 8 fully reduced keys.
+ */
+static __m256i libhonoka__v2_update_avx2(__m256i s)
+{
+	const __m256i p = _mm256_set1_epi32(2147483647);
+	__m256i u = libhonoka__mul16807_avx2(_mm256_srli_epi32(s, 16));
+	__m256i b = _mm256_add_epi32(
+		_mm256_and_si256(_mm256_slli_epi32(u, 16), p),
+		libhonoka__mul16807_avx2(_mm256_and_si256(s, _mm256_set1_epi32(65535)))
+	);
+
+	/* b + c, minus 2^31 - 1 if b > 2^31 - 2 */
+	return _mm256_sub_epi32(
+		_mm256_add_epi32(b, _mm256_srli_epi32(u, 15)),
+		_mm256_and_si256(_mm256_srai_epi32(b, 31), p)
+	);
+}
+
+/*!
+ * Multiply 8 fully reduced keys by `m` modulo 2^31 - 1.
+ */
+static __m256i libhonoka__v2_mulmod_avx2(__m256i s, __m256i m)
+{
+	const __m256i p = _mm256_set1_epi32(2147483647);
+	const __m256i p64 = _mm256_set1_epi64x(2147483647);
+	__m256i even = _mm256_mul_epu32(s, m);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(s, 32), m);
+
+	/* 2^31 = 1 in modulo 2^31 - 1. After the first fold it fits in 32-bit */
+	even = _mm256_add_epi64(_mm256_and_si256(even, p64), _mm256_srli_epi64(even, 31));
+	odd = _mm256_add_epi64(_mm256_and_si256(odd, p64), _mm256_srli_epi64(odd, 31));
+	s = _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+	s = _mm256_add_epi32(_mm256_and_si256(s, p), _mm256_srli_epi32(s, 31));
+	return _mm256_add_epi32(_mm256_and_si256(s, p), _mm256_srli_epi32(s, 31));
+}
+
+/*!
+ * Extract the 2 keystream bytes of version 2 keys.
+ */
+static __m256i libhonoka__v2_word_avx2(__m256i k)
+{
+	return _mm256_or_si256(
+		_mm256_and_si256(_mm256_srli_epi32(k, 23), _mm256_set1_epi32(255)),
+		_mm256_and_si256(_mm256_srli_epi32(k, 7), _mm256_set1_epi32(65280))
+	);
+}
+
+size_t libhonoka__v2_xor_avx2(
+	unsigned int        *key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 16 lanes, 2 bytes each, in 2 registers */
+	unsigned int lanes[16];
+	unsigned int mul_val;
+	__m256i s0, s1, vmul;
+	size_t blocks = size >> 5, i;
+
+	if (blocks == 0 || !libhonoka__v2_lanes(*key, lanes, 16, &mul_val))
+		return 0;
+
+	s0 = libhonoka__load2x4_avx2(&lanes[0], &lanes[8]);
+	s1 = libhonoka__load2x4_avx2(&lanes[4], &lanes[12]);
+	vmul = _mm256_set1_epi32((int) mul_val);
+
+	for (i = 0; i < blocks; i++, in += 32, out += 32)
+	{
+		__m256i ks = _mm256_packus_epi32(
+			libhonoka__v2_word_avx2(libhonoka__v2_update_avx2(s0)),
+			libhonoka__v2_word_avx2(libhonoka__v2_update_avx2(s1))
+		);
+
+		_mm256_storeu_si256((__m256i *) out, _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *) in), ks
+		));
+		s0 = libhonoka__v2_mulmod_avx2(s0, vmul);
+		s1 = libhonoka__v2_mulmod_avx2(s1, vmul);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(
+		_mm256_castsi256_si128(libhonoka__v2_update_avx2(s0))
+	);
+	return blocks << 5;
+}
+
+size_t libhonoka__lcg_xor_avx2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 32 LCG lanes, 1 byte each, in 4 registers. Register `r` holds */
+	/* bytes 4r to 4r+3 in the low half and 4r+16 to 4r+19 in the high half */
+	unsigned int lanes[32];
+	unsigned int mul_val, add_val;
+	__m256i s0, s1, s2, s3, vmul, vadd, mask;
+	__m128i shift;
+	size_t blocks = size >> 5, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 32, &mul_val, &add_val);
+	s0 = libhonoka__load2x4_avx2(&lanes[0], &lanes[16]);
+	s1 = libhonoka__load2x4_avx2(&lanes[4], &lanes[20]);
+	s2 = libhonoka__load2x4_avx2(&lanes[8], &lanes[24]);
+	s3 = libhonoka__load2x4_avx2(&lanes[12], &lanes[28]);
+	vmul = _mm256_set1_epi32((int) mul_val);
+	vadd = _mm256_set1_epi32((int) add_val);
+	mask = _mm256_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+
+	for (i = 0; i < blocks; i++, in += 32, out += 32)
+	{
+		__m256i ks = libhonoka__pack4_avx2(s0, s1, s2, s3, shift, mask);
+
+		_mm256_storeu_si256((__m256i *) out, _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *) in), ks
+		));
+
+		s0 = _mm256_add_epi32(_mm256_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm256_add_epi32(_mm256_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm256_add_epi32(_mm256_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm256_add_epi32(_mm256_mullo_epi32(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm256_cvtsi256_si32(s0);
+	return blocks << 5;
+}
+
+size_t libhonoka__lcg2_xor_avx2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned int         *key2,
+	const libhonoka__lcg *lcg2,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 32 lanes of both LCGs, same layout as libhonoka__lcg_xor_avx2 */
+	unsigned int lanes[32], lanes2[32];
+	unsigned int mul_val, add_val, mul_val2, add_val2;
+	__m256i s0, s1, s2, s3, t0, t1, t2, t3;
+	__m256i vmul, vadd, vmul2, vadd2, mask;
+	__m128i shift, shift2;
+	size_t blocks = size >> 5, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 32, &mul_val, &add_val);
+	libhonoka__lcg_lanes(*key2, lcg2, lanes2, 32, &mul_val2, &add_val2);
+	s0 = libhonoka__load2x4_avx2(&lanes[0], &lanes[16]);
+	s1 = libhonoka__load2x4_avx2(&lanes[4], &lanes[20]);
+	s2 = libhonoka__load2x4_avx2(&lanes[8], &lanes[24]);
+	s3 = libhonoka__load2x4_avx2(&lanes[12], &lanes[28]);
+	t0 = libhonoka__load2x4_avx2(&lanes2[0], &lanes2[16]);
+	t1 = libhonoka__load2x4_avx2(&lanes2[4], &lanes2[20]);
+	t2 = libhonoka__load2x4_avx2(&lanes2[8], &lanes2[24]);
+	t3 = libhonoka__load2x4_avx2(&lanes2[12], &lanes2[28]);
+	vmul = _mm256_set1_epi32((int) mul_val);
+	vadd = _mm256_set1_epi32((int) add_val);
+	vmul2 = _mm256_set1_epi32((int) mul_val2);
+	vadd2 = _mm256_set1_epi32((int) add_val2);
+	mask = _mm256_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	shift2 = _mm_cvtsi32_si128((int) lcg2->shift_val);
+
+#define LIBHONOKA_V6_KEY(s, t) _mm256_xor_si256( \
+	_mm256_srl_epi32(s, shift), _mm256_srl_epi32(t, shift2))
+
+	for (i = 0; i < blocks; i++, in += 32, out += 32)
+	{
+		/* Shift by 0 as the keys are combined already */
+		__m256i ks = libhonoka__pack4_avx2(
+			LIBHONOKA_V6_KEY(s0, t0), LIBHONOKA_V6_KEY(s1, t1),
+			LIBHONOKA_V6_KEY(s2, t2), LIBHONOKA_V6_KEY(s3, t3),
+			_mm_setzero_si128(), mask
+		);
+
+		_mm256_storeu_si256((__m256i *) out, _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *) in), ks
+		));
+
+		s0 = _mm256_add_epi32(_mm256_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm256_add_epi32(_mm256_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm256_add_epi32(_mm256_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm256_add_epi32(_mm256_mullo_epi32(s3, vmul), vadd);
+		t0 = _mm256_add_epi32(_mm256_mullo_epi32(t0, vmul2), vadd2);
+		t1 = _mm256_add_epi32(_mm256_mullo_epi32(t1, vmul2), vadd2);
+		t2 = _mm256_add_epi32(_mm256_mullo_epi32(t2, vmul2), vadd2);
+		t3 = _mm256_add_epi32(_mm256_mullo_epi32(t3, vmul2), vadd2);
+	}
+
+#undef LIBHONOKA_V6_KEY
+
+	*key = (unsigned int) _mm256_cvtsi256_si32(s0);
+	*key2 = (unsigned int) _mm256_cvtsi256_si32(t0);
+	return blocks << 5;
+}
+
+size_t libhonoka__v5_decrypt_avx2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_avx2 */
+	unsigned int lanes[32];
+	unsigned int mul_val, add_val;
+	__m256i s0, s1, s2, s3, vmul, vadd, mask, last;
+	__m128i shift;
+	size_t blocks = size >> 5, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 32, &mul_val, &add_val);
+	s0 = libhonoka__load2x4_avx2(&lanes[0], &lanes[16]);
+	s1 = libhonoka__load2x4_avx2(&lanes[4], &lanes[20]);
+	s2 = libhonoka__load2x4_avx2(&lanes[8], &lanes[24]);
+	s3 = libhonoka__load2x4_avx2(&lanes[12], &lanes[28]);
+	vmul = _mm256_set1_epi32((int) mul_val);
+	vadd = _mm256_set1_epi32((int) add_val);
+	mask = _mm256_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	/* Previous encrypted byte in the last byte */
+	last = _mm256_set1_epi8((char) *chain);
+
+	for (i = 0; i < blocks; i++, in += 32, out += 32)
+	{
+		__m256i ks = libhonoka__pack4_avx2(s0, s1, s2, s3, shift, mask);
+		__m256i cur = _mm256_loadu_si256((const __m256i *) in);
+		/* The encrypted bytes, shifted by 1 byte. Kept in register, so */
+		/* `in` can be the same as `out` */
+		__m256i prev = _mm256_alignr_epi8(
+			cur,
+			_mm256_permute2x128_si256(last, cur, 0x21),
+			15
+		);
+
+		_mm256_storeu_si256((__m256i *) out, _mm256_xor_si256(
+			_mm256_xor_si256(cur, prev), ks
+		));
+		last = cur;
+
+		s0 = _mm256_add_epi32(_mm256_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm256_add_epi32(_mm256_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm256_add_epi32(_mm256_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm256_add_epi32(_mm256_mullo_epi32(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm256_cvtsi256_si32(s0);
+	*chain = (unsigned char) _mm256_extract_epi8(last, 31);
+	return blocks << 5;
+}
+
+size_t libhonoka__v5_encrypt_avx2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_avx2 */
+	unsigned int lanes[32];
+	unsigned int mul_val, add_val;
+	__m256i s0, s1, s2, s3, vmul, vadd, mask, carry, last_idx;
+	__m128i shift;
+	size_t blocks = size >> 5, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 32, &mul_val, &add_val);
+	s0 = libhonoka__load2x4_avx2(&lanes[0], &lanes[16]);
+	s1 = libhonoka__load2x4_avx2(&lanes[4], &lanes[20]);
+	s2 = libhonoka__load2x4_avx2(&lanes[8], &lanes[24]);
+	s3 = libhonoka__load2x4_avx2(&lanes[12], &lanes[28]);
+	vmul = _mm256_set1_epi32((int) mul_val);
+	vadd = _mm256_set1_epi32((int) add_val);
+	mask = _mm256_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	last_idx = _mm256_set1_epi8(15);
+	/* Previous encrypted byte in all bytes */
+	carry = _mm256_set1_epi8((char) *chain);
+
+	for (i = 0; i < blocks; i++, in += 32, out += 32)
+	{
+		__m256i x = _mm256_xor_si256(
+			_mm256_loadu_si256((const __m256i *) in),
+			libhonoka__pack4_avx2(s0, s1, s2, s3, shift, mask)
+		);
+		__m256i t;
+
+		/* Encrypted byte is XOR of all bytes so far: prefix XOR each */
+		/* half, then carry the low half into the high half */
+		x = _mm256_xor_si256(x, _mm256_slli_si256(x, 1));
+		x = _mm256_xor_si256(x, _mm256_slli_si256(x, 2));
+		x = _mm256_xor_si256(x, _mm256_slli_si256(x, 4));
+		x = _mm256_xor_si256(x, _mm256_slli_si256(x, 8));
+		t = _mm256_shuffle_epi8(x, last_idx);
+		x = _mm256_xor_si256(x, _mm256_permute2x128_si256(t, t, 0x08));
+		x = _mm256_xor_si256(x, carry);
+		_mm256_storeu_si256((__m256i *) out, x);
+
+		/* Broadcast the last byte */
+		t = _mm256_shuffle_epi8(x, last_idx);
+		carry = _mm256_permute2x128_si256(t, t, 0x11);
+
+		s0 = _mm256_add_epi32(_mm256_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm256_add_epi32(_mm256_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm256_add_epi32(_mm256_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm256_add_epi32(_mm256_mullo_epi32(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm256_cvtsi256_si32(s0);
+	*chain = (unsigned char) _mm256_cvtsi256_si32(carry);
+	return blocks << 5;
+}
+
+/* One file per 128 bits */
+#define LIBHONOKA_FILES_VEC __m256i
+#define LIBHONOKA_FILES_PARTS 2
+#define LIBHONOKA_FILES_LOAD(p) _mm256_loadu_si256((const __m256i *) (p))
+#define LIBHONOKA_FILES_STORE(p, x) _mm256_storeu_si256((__m256i *) (p), x)
+#define LIBHONOKA_FILES_SET1(x) _mm256_set1_epi32((int) (x))
+#define LIBHONOKA_FILES_ADD(x, y) _mm256_add_epi32(x, y)
+#define LIBHONOKA_FILES_MUL(x, y) _mm256_mullo_epi32(x, y)
+#define LIBHONOKA_FILES_AND(x, y) _mm256_and_si256(x, y)
+#define LIBHONOKA_FILES_XOR(x, y) _mm256_xor_si256(x, y)
+#define LIBHONOKA_FILES_SHIFT(p) LIBHONOKA_FILES_LOAD(p)
+#define LIBHONOKA_FILES_SRL(x, n) _mm256_srlv_epi32(x, n)
+#define LIBHONOKA_FILES_PACKS32(x, y) _mm256_packs_epi32(x, y)
+#define LIBHONOKA_FILES_PACKUS16(x, y) _mm256_packus_epi16(x, y)
+#define LIBHONOKA_FILES_PART(x, k) _mm256_extracti128_si256(x, k)
+#define LIBHONOKA_FILES_FUNC libhonoka__files_xor_avx2
+#include "honokamiku_files_lanes.h"
+#define LIBHONOKA_FILES_FUNC libhonoka__files2_xor_avx2
+#define LIBHONOKA_FILES_SECOND
+#include "honokamiku_files_lanes.h"
+
+/* MD5 of one message per lane */
+#define LIBHONOKA_MD5_VEC __m256i
+#define LIBHONOKA_MD5_LANES 8
+#define LIBHONOKA_MD5_LOAD(p) _mm256_loadu_si256((const __m256i *) (p))
+#define LIBHONOKA_MD5_STORE(p, x) _mm256_storeu_si256((__m256i *) (p), x)
+#define LIBHONOKA_MD5_SET1(x) _mm256_set1_epi32((int) (x))
+#define LIBHONOKA_MD5_ADD(x, y) _mm256_add_epi32(x, y)
+#define LIBHONOKA_MD5_AND(x, y) _mm256_and_si256(x, y)
+#define LIBHONOKA_MD5_OR(x, y) _mm256_or_si256(x, y)
+#define LIBHONOKA_MD5_XOR(x, y) _mm256_xor_si256(x, y)
+#define LIBHONOKA_MD5_ROTL(x, n) _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+#define LIBHONOKA_MD5_LESS(x, y) _mm256_cmpgt_epi32(y, x)
+#define LIBHONOKA_MD5_FUNC libhonoka__md5_avx2
+#include "honokamiku_md5_lanes.h"
+
+#endif /* __AVX2__ */
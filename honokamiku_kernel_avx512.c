@@ -0,0 +1,481 @@
+/*!
+ * \file honokamiku_kernel_avx512.c
+ * AVX-512 multi-lane decryption kernels
+ */
+
+#include "honokamiku_internal.h"
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+/*!
+ * Load 64 LCG lanes into 4 registers. Register `r` holds bytes 4r to 4r+3
+ * of each 16 bytes, so that the in-lane packs yield the bytes in order.
+ */
+static void libhonoka__load4_avx512(
+	const unsigned int *lanes,
+	__m512i *s0, __m512i *s1, __m512i *s2, __m512i *s3
+)
+{
+	unsigned int order[64];
+	size_t r, j, k;
+
+	for (r = 0; r < 4; r++)
+		for (j = 0; j < 4; j++)
+			for (k = 0; k < 4; k++)
+				order[r * 16 + j * 4 + k] = lanes[j * 16 + r * 4 + k];
+
+	*s0 = _mm512_loadu_si512(&order[0]);
+	*s1 = _mm512_loadu_si512(&order[16]);
+	*s2 = _mm512_loadu_si512(&order[32]);
+	*s3 = _mm512_loadu_si512(&order[48]);
+}
+
+/*!
+ * Extract the keystream byte of 4 registers of 16 LCG lanes, in order.
+ */
+static __m512i libhonoka__pack4_avx512(
+	__m512i s0, __m512i s1, __m512i s2, __m512i s3,
+	__m128i shift, __m512i mask
+)
+{
+	return _mm512_packus_epi16(
+		_mm512_packs_epi32(
+			_mm512_and_si512(_mm512_srl_epi32(s0, shift), mask),
+			_mm512_and_si512(_mm512_srl_epi32(s1, shift), mask)
+		),
+		_mm512_packs_epi32(
+			_mm512_and_si512(_mm512_srl_epi32(s2, shift), mask),
+			_mm512_and_si512(_mm512_srl_epi32(s3, shift), mask)
+		)
+	);
+}
+
+size_t libhonoka__v1_xor_avx512(
+	unsigned int        *key,
+	unsigned int         update_key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 16 keys, 4 bytes each */
+	__m512i k, step, bswap;
+	size_t blocks = size >> 6, i;
+
+	if (blocks == 0)
+		return 0;
+
+	k = _mm512_add_epi32(
+		_mm512_set1_epi32((int) *key),
+		_mm512_mullo_epi32(
+			_mm512_set1_epi32((int) update_key),
+			_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+		)
+	);
+	step = _mm512_set1_epi32((int) (update_key * 16));
+	bswap = _mm512_broadcast_i32x4(_mm_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+	));
+
+	for (i = 0; i < blocks; i++, in += 64, out += 64)
+	{
+		_mm512_storeu_si512(out, _mm512_xor_si512(
+			_mm512_loadu_si512(in),
+			_mm512_shuffle_epi8(k, bswap)
+		));
+		k = _mm512_add_epi32(k, step);
+	}
+
+	*key += (unsigned int) (blocks << 4) * update_key;
+	return blocks << 6;
+}
+
+/*!
+ * Load 32 lanes into 2 registers. Register `r` holds lanes 4r to 4r+3 of
+ * each 8 lanes, so that the in-lane pack yields the words in order.
+ */
+static void libhonoka__load2_avx512(
+	const unsigned int *lanes,
+	__m512i *s0, __m512i *s1
+)
+{
+	unsigned int order[32];
+	size_t r, j, k;
+
+	for (r = 0; r < 2; r++)
+		for (j = 0; j < 4; j++)
+			for (k = 0; k < 4; k++)
+				order[r * 16 + j * 4 + k] = lanes[j * 8 + r * 4 + k];
+
+	*s0 = _mm512_loadu_si512(&order[0]);
+	*s1 = _mm512_loadu_si512(&order[16]);
+}
+
+/*!
+ * Multiply each 16-bit lane value (upper 16 bits must be 0) by 16807.
+ */
+static __m512i libhonoka__mul16807_avx512(__m512i x)
+{
+	const __m512i k = _mm512_set1_epi32(16807);
+
+	return _mm512_or_si512(
+		_mm512_mullo_epi16(x, k),
+		_mm512_slli_epi32(_mm512_mulhi_epu16(x, k), 16)
+	);
+}
+
+/*!
+ * Branch-free honokamiku_update_v2 of 16 fully reduced keys.
+ */
+static __m512i libhonoka__v2_update_avx512(__m512i s)
+{
+	const __m512i p = _mm512_set1_epi32(2147483647);
+	__m512i u = libhonoka__mul16807_avx512(_mm512_srli_epi32(s, 16));
+	__m512i b = _mm512_add_epi32(
+		_mm512_and_si512(_mm512_slli_epi32(u, 16), p),
+		libhonoka__mul16807_avx512(_mm512_and_si512(s, _mm512_set1_epi32(65535)))
+	);
+
+	/* b + c, minus 2^31 - 1 if b > 2^31 - 2 */
+	return _mm512_sub_epi32(
+		_mm512_add_epi32(b, _mm512_srli_epi32(u, 15)),
+		_mm512_and_si512(_mm512_srai_epi32(b, 31), p)
+	);
+}
+
+/*!
+ * Multiply 16 fully reduced keys by `m` modulo 2^31 - 1.
+ */
+static __m512i libhonoka__v2_mulmod_avx512(__m512i s, __m512i m)
+{
+	const __m512i p = _mm512_set1_epi32(2147483647);
+	const __m512i p64 = _mm512_set1_epi64(2147483647);
+	__m512i even = _mm512_mul_epu32(s, m);
+	__m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(s, 32), m);
+
+	/* 2^31 = 1 in modulo 2^31 - 1. After the first fold it fits in 32-bit */
+	even = _mm512_add_epi64(_mm512_and_si512(even, p64), _mm512_srli_epi64(even, 31));
+	odd = _mm512_add_epi64(_mm512_and_si512(odd, p64), _mm512_srli_epi64(odd, 31));
+	s = _mm512_or_si512(even, _mm512_slli_epi64(odd, 32));
+	s = _mm512_add_epi32(_mm512_and_si512(s, p), _mm512_srli_epi32(s, 31));
+	return _mm512_add_epi32(_mm512_and_si512(s, p), _mm512_srli_epi32(s, 31));
+}
+
+/*!
+ * Extract the 2 keystream bytes of version 2 keys.
+ */
+static __m512i libhonoka__v2_word_avx512(__m512i k)
+{
+	return _mm512_or_si512(
+		_mm512_and_si512(_mm512_srli_epi32(k, 23), _mm512_set1_epi32(255)),
+		_mm512_and_si512(_mm512_srli_epi32(k, 7), _mm512_set1_epi32(65280))
+	);
+}
+
+size_t libhonoka__v2_xor_avx512(
+	unsigned int        *key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 32 lanes, 2 bytes each, in 2 registers */
+	unsigned int lanes[32];
+	unsigned int mul_val;
+	__m512i s0, s1, vmul;
+	size_t blocks = size >> 6, i;
+
+	if (blocks == 0 || !libhonoka__v2_lanes(*key, lanes, 32, &mul_val))
+		return 0;
+
+	libhonoka__load2_avx512(lanes, &s0, &s1);
+	vmul = _mm512_set1_epi32((int) mul_val);
+
+	for (i = 0; i < blocks; i++, in += 64, out += 64)
+	{
+		__m512i ks = _mm512_packus_epi32(
+			libhonoka__v2_word_avx512(libhonoka__v2_update_avx512(s0)),
+			libhonoka__v2_word_avx512(libhonoka__v2_update_avx512(s1))
+		);
+
+		_mm512_storeu_si512(out, _mm512_xor_si512(
+			_mm512_loadu_si512(in), ks
+		));
+		s0 = libhonoka__v2_mulmod_avx512(s0, vmul);
+		s1 = libhonoka__v2_mulmod_avx512(s1, vmul);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(
+		_mm512_castsi512_si128(libhonoka__v2_update_avx512(s0))
+	);
+	return blocks << 6;
+}
+
+size_t libhonoka__lcg_xor_avx512(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 64 LCG lanes, 1 byte each, in 4 registers */
+	unsigned int lanes[64];
+	unsigned int mul_val, add_val;
+	__m512i s0, s1, s2, s3, vmul, vadd, mask;
+	__m128i shift;
+	size_t blocks = size >> 6, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 64, &mul_val, &add_val);
+	libhonoka__load4_avx512(lanes, &s0, &s1, &s2, &s3);
+	vmul = _mm512_set1_epi32((int) mul_val);
+	vadd = _mm512_set1_epi32((int) add_val);
+	mask = _mm512_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+
+	for (i = 0; i < blocks; i++, in += 64, out += 64)
+	{
+		__m512i ks = libhonoka__pack4_avx512(s0, s1, s2, s3, shift, mask);
+
+		_mm512_storeu_si512(out, _mm512_xor_si512(_mm512_loadu_si512(in), ks));
+
+		s0 = _mm512_add_epi32(_mm512_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm512_add_epi32(_mm512_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm512_add_epi32(_mm512_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm512_add_epi32(_mm512_mullo_epi32(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(_mm512_castsi512_si128(s0));
+	return blocks << 6;
+}
+
+size_t libhonoka__lcg2_xor_avx512(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned int         *key2,
+	const libhonoka__lcg *lcg2,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 64 lanes of both LCGs, 1 byte each, in 4 registers each */
+	unsigned int lanes[64], lanes2[64];
+	unsigned int mul_val, add_val, mul_val2, add_val2;
+	__m512i s0, s1, s2, s3, t0, t1, t2, t3;
+	__m512i vmul, vadd, vmul2, vadd2, mask;
+	__m128i shift, shift2;
+	size_t blocks = size >> 6, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 64, &mul_val, &add_val);
+	libhonoka__lcg_lanes(*key2, lcg2, lanes2, 64, &mul_val2, &add_val2);
+	libhonoka__load4_avx512(lanes, &s0, &s1, &s2, &s3);
+	libhonoka__load4_avx512(lanes2, &t0, &t1, &t2, &t3);
+	vmul = _mm512_set1_epi32((int) mul_val);
+	vadd = _mm512_set1_epi32((int) add_val);
+	mask = _mm512_set1_epi32(255);
+	vmul2 = _mm512_set1_epi32((int) mul_val2);
+	vadd2 = _mm512_set1_epi32((int) add_val2);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	shift2 = _mm_cvtsi32_si128((int) lcg2->shift_val);
+
+#define LIBHONOKA_V6_KEY(s, t) _mm512_xor_si512( \
+	_mm512_srl_epi32(s, shift), _mm512_srl_epi32(t, shift2))
+
+	for (i = 0; i < blocks; i++, in += 64, out += 64)
+	{
+		/* Shift by 0 as the keys are combined already */
+		__m512i ks = libhonoka__pack4_avx512(
+			LIBHONOKA_V6_KEY(s0, t0), LIBHONOKA_V6_KEY(s1, t1),
+			LIBHONOKA_V6_KEY(s2, t2), LIBHONOKA_V6_KEY(s3, t3),
+			_mm_setzero_si128(), mask
+		);
+
+		_mm512_storeu_si512(out, _mm512_xor_si512(_mm512_loadu_si512(in), ks));
+
+		s0 = _mm512_add_epi32(_mm512_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm512_add_epi32(_mm512_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm512_add_epi32(_mm512_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm512_add_epi32(_mm512_mullo_epi32(s3, vmul), vadd);
+		t0 = _mm512_add_epi32(_mm512_mullo_epi32(t0, vmul2), vadd2);
+		t1 = _mm512_add_epi32(_mm512_mullo_epi32(t1, vmul2), vadd2);
+		t2 = _mm512_add_epi32(_mm512_mullo_epi32(t2, vmul2), vadd2);
+		t3 = _mm512_add_epi32(_mm512_mullo_epi32(t3, vmul2), vadd2);
+	}
+
+#undef LIBHONOKA_V6_KEY
+
+	*key = (unsigned int) _mm_cvtsi128_si32(_mm512_castsi512_si128(s0));
+	*key2 = (unsigned int) _mm_cvtsi128_si32(_mm512_castsi512_si128(t0));
+	return blocks << 6;
+}
+
+size_t libhonoka__v5_decrypt_avx512(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_avx512 */
+	unsigned int lanes[64];
+	unsigned int mul_val, add_val;
+	__m512i s0, s1, s2, s3, vmul, vadd, mask, last;
+	__m128i shift;
+	size_t blocks = size >> 6, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 64, &mul_val, &add_val);
+	libhonoka__load4_avx512(lanes, &s0, &s1, &s2, &s3);
+	vmul = _mm512_set1_epi32((int) mul_val);
+	vadd = _mm512_set1_epi32((int) add_val);
+	mask = _mm512_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	/* Previous encrypted byte in the last byte */
+	last = _mm512_set1_epi32((int) ((unsigned int) *chain << 24));
+
+	for (i = 0; i < blocks; i++, in += 64, out += 64)
+	{
+		__m512i ks = libhonoka__pack4_avx512(s0, s1, s2, s3, shift, mask);
+		__m512i cur = _mm512_loadu_si512(in);
+		/* The encrypted bytes, shifted by 1 byte: shift each dword and */
+		/* bring in the top byte of the dword before it. Kept in register, */
+		/* so `in` can be the same as `out` */
+		__m512i prev = _mm512_or_si512(
+			_mm512_slli_epi32(cur, 8),
+			_mm512_srli_epi32(_mm512_alignr_epi32(cur, last, 15), 24)
+		);
+
+		_mm512_storeu_si512(out, _mm512_xor_si512(_mm512_xor_si512(cur, prev), ks));
+		last = cur;
+
+		s0 = _mm512_add_epi32(_mm512_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm512_add_epi32(_mm512_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm512_add_epi32(_mm512_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm512_add_epi32(_mm512_mullo_epi32(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(_mm512_castsi512_si128(s0));
+	*chain = (unsigned char) _mm_cvtsi128_si32(
+		_mm_srli_si128(_mm512_extracti32x4_epi32(last, 3), 15)
+	);
+	return blocks << 6;
+}
+
+size_t libhonoka__v5_encrypt_avx512(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_avx512 */
+	unsigned int lanes[64];
+	unsigned int mul_val, add_val;
+	__m512i s0, s1, s2, s3, vmul, vadd, mask, carry, zero, last_idx;
+	__m128i shift;
+	size_t blocks = size >> 6, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 64, &mul_val, &add_val);
+	libhonoka__load4_avx512(lanes, &s0, &s1, &s2, &s3);
+	vmul = _mm512_set1_epi32((int) mul_val);
+	vadd = _mm512_set1_epi32((int) add_val);
+	mask = _mm512_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	zero = _mm512_setzero_si512();
+	last_idx = _mm512_set1_epi32(15);
+	/* Previous encrypted byte in all bytes */
+	carry = _mm512_set1_epi8((char) *chain);
+
+	for (i = 0; i < blocks; i++, in += 64, out += 64)
+	{
+		__m512i x = _mm512_xor_si512(
+			_mm512_loadu_si512(in),
+			libhonoka__pack4_avx512(s0, s1, s2, s3, shift, mask)
+		);
+		__m512i t;
+
+		/* Encrypted byte is XOR of all bytes so far. Prefix XOR each */
+		/* dword, then prefix XOR the dword totals and carry them over */
+		x = _mm512_xor_si512(x, _mm512_slli_epi32(x, 8));
+		x = _mm512_xor_si512(x, _mm512_slli_epi32(x, 16));
+		t = _mm512_srli_epi32(x, 24);
+		t = _mm512_or_si512(t, _mm512_slli_epi32(t, 8));
+		t = _mm512_or_si512(t, _mm512_slli_epi32(t, 16));
+		t = _mm512_xor_si512(t, _mm512_alignr_epi32(t, zero, 15));
+		t = _mm512_xor_si512(t, _mm512_alignr_epi32(t, zero, 14));
+		t = _mm512_xor_si512(t, _mm512_alignr_epi32(t, zero, 12));
+		t = _mm512_xor_si512(t, _mm512_alignr_epi32(t, zero, 8));
+		x = _mm512_xor_si512(x, _mm512_alignr_epi32(t, zero, 15));
+		x = _mm512_xor_si512(x, carry);
+		_mm512_storeu_si512(out, x);
+
+		/* Total of the block is in the last dword */
+		carry = _mm512_xor_si512(carry, _mm512_permutexvar_epi32(last_idx, t));
+
+		s0 = _mm512_add_epi32(_mm512_mullo_epi32(s0, vmul), vadd);
+		s1 = _mm512_add_epi32(_mm512_mullo_epi32(s1, vmul), vadd);
+		s2 = _mm512_add_epi32(_mm512_mullo_epi32(s2, vmul), vadd);
+		s3 = _mm512_add_epi32(_mm512_mullo_epi32(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(_mm512_castsi512_si128(s0));
+	*chain = (unsigned char) _mm_cvtsi128_si32(_mm512_castsi512_si128(carry));
+	return blocks << 6;
+}
+
+/* One file per 128 bits */
+#define LIBHONOKA_FILES_VEC __m512i
+#define LIBHONOKA_FILES_PARTS 4
+#define LIBHONOKA_FILES_LOAD(p) _mm512_loadu_si512((const void *) (p))
+#define LIBHONOKA_FILES_STORE(p, x) _mm512_storeu_si512((void *) (p), x)
+#define LIBHONOKA_FILES_SET1(x) _mm512_set1_epi32((int) (x))
+#define LIBHONOKA_FILES_ADD(x, y) _mm512_add_epi32(x, y)
+#define LIBHONOKA_FILES_MUL(x, y) _mm512_mullo_epi32(x, y)
+#define LIBHONOKA_FILES_AND(x, y) _mm512_and_si512(x, y)
+#define LIBHONOKA_FILES_XOR(x, y) _mm512_xor_si512(x, y)
+#define LIBHONOKA_FILES_SHIFT(p) LIBHONOKA_FILES_LOAD(p)
+#define LIBHONOKA_FILES_SRL(x, n) _mm512_srlv_epi32(x, n)
+#define LIBHONOKA_FILES_PACKS32(x, y) _mm512_packs_epi32(x, y)
+#define LIBHONOKA_FILES_PACKUS16(x, y) _mm512_packus_epi16(x, y)
+#define LIBHONOKA_FILES_PART(x, k) _mm512_extracti32x4_epi32(x, k)
+#define LIBHONOKA_FILES_FUNC libhonoka__files_xor_avx512
+#include "honokamiku_files_lanes.h"
+#define LIBHONOKA_FILES_FUNC libhonoka__files2_xor_avx512
+#define LIBHONOKA_FILES_SECOND
+#include "honokamiku_files_lanes.h"
+
+/* MD5 of one message per lane */
+#define LIBHONOKA_MD5_VEC __m512i
+#define LIBHONOKA_MD5_LANES 16
+#define LIBHONOKA_MD5_LOAD(p) _mm512_loadu_si512((const void *) (p))
+#define LIBHONOKA_MD5_STORE(p, x) _mm512_storeu_si512((void *) (p), x)
+#define LIBHONOKA_MD5_SET1(x) _mm512_set1_epi32((int) (x))
+#define LIBHONOKA_MD5_ADD(x, y) _mm512_add_epi32(x, y)
+#define LIBHONOKA_MD5_AND(x, y) _mm512_and_si512(x, y)
+#define LIBHONOKA_MD5_OR(x, y) _mm512_or_si512(x, y)
+#define LIBHONOKA_MD5_XOR(x, y) _mm512_xor_si512(x, y)
+#define LIBHONOKA_MD5_ROTL(x, n) _mm512_rol_epi32(x, n)
+#define LIBHONOKA_MD5_LESS(x, y) \
+	_mm512_maskz_mov_epi32(_mm512_cmplt_epu32_mask(x, y), _mm512_set1_epi32(-1))
+#define LIBHONOKA_MD5_FUNC libhonoka__md5_avx512
+#include "honokamiku_md5_lanes.h"
+
+#endif /* __AVX512F__ && __AVX512BW__ */
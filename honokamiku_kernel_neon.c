@@ -0,0 +1,365 @@
+/*!
+ * \file honokamiku_kernel_neon.c
+ * AArch64 NEON multi-lane decryption kernels. Not verified on AArch64
+ * hardware yet, so only used with HONOKAMIKU_KERNEL=neon until the
+ * ubuntu-24.04-arm CI job has passed its "Kernel Test" step
+ */
+
+#include "honokamiku_internal.h"
+
+#ifdef LIBHONOKA_KERNEL_NEON
+
+#include <arm_neon.h>
+
+/*!
+ * Take the low byte of each lane of 4 registers of 4 lanes, in order.
+ */
+static uint8x16_t libhonoka__narrow4_neon(
+	uint32x4_t a0, uint32x4_t a1, uint32x4_t a2, uint32x4_t a3
+)
+{
+	return vcombine_u8(
+		vmovn_u16(vcombine_u16(vmovn_u32(a0), vmovn_u32(a1))),
+		vmovn_u16(vcombine_u16(vmovn_u32(a2), vmovn_u32(a3)))
+	);
+}
+
+/*!
+ * Load 16 LCG lanes into 4 registers and compute the 16-step LCG parameters.
+ */
+static void libhonoka__lcg_load_neon(
+	unsigned int          key,
+	const libhonoka__lcg *lcg,
+	uint32x4_t           *s,
+	uint32x4_t           *vmul,
+	uint32x4_t           *vadd
+)
+{
+	unsigned int lanes[16];
+	unsigned int mul_val, add_val;
+
+	libhonoka__lcg_lanes(key, lcg, lanes, 16, &mul_val, &add_val);
+	s[0] = vld1q_u32(&lanes[0]);
+	s[1] = vld1q_u32(&lanes[4]);
+	s[2] = vld1q_u32(&lanes[8]);
+	s[3] = vld1q_u32(&lanes[12]);
+	*vmul = vdupq_n_u32(mul_val);
+	*vadd = vdupq_n_u32(add_val);
+}
+
+/*!
+ * Keystream bytes of 16 LCG lanes, then advance the lanes by 16 steps.
+ */
+static uint8x16_t libhonoka__lcg_next_neon(
+	uint32x4_t *s, uint32x4_t vmul, uint32x4_t vadd, int32x4_t shift
+)
+{
+	uint8x16_t ks = libhonoka__narrow4_neon(
+		vshlq_u32(s[0], shift), vshlq_u32(s[1], shift),
+		vshlq_u32(s[2], shift), vshlq_u32(s[3], shift)
+	);
+
+	s[0] = vmlaq_u32(vadd, s[0], vmul);
+	s[1] = vmlaq_u32(vadd, s[1], vmul);
+	s[2] = vmlaq_u32(vadd, s[2], vmul);
+	s[3] = vmlaq_u32(vadd, s[3], vmul);
+	return ks;
+}
+
+size_t libhonoka__v1_xor_neon(
+	unsigned int        *key,
+	unsigned int         update_key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 4 keys, 4 bytes each */
+	unsigned int first[4];
+	uint32x4_t k, step;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	first[0] = *key;
+	first[1] = *key + update_key;
+	first[2] = *key + update_key * 2;
+	first[3] = *key + update_key * 3;
+	k = vld1q_u32(first);
+	step = vdupq_n_u32(update_key * 4);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		/* Keys are XOR-ed most significant byte first */
+		vst1q_u8(out, veorq_u8(
+			vld1q_u8(in),
+			vrev32q_u8(vreinterpretq_u8_u32(k))
+		));
+		k = vaddq_u32(k, step);
+	}
+
+	*key += (unsigned int) (blocks << 2) * update_key;
+	return blocks << 4;
+}
+
+/*!
+ * Branch-free honokamiku_update_v2 of 4 fully reduced keys.
+ */
+static uint32x4_t libhonoka__v2_update_neon(uint32x4_t s)
+{
+	const uint32x4_t p = vdupq_n_u32(2147483647);
+	uint32x4_t u = vmulq_n_u32(vshrq_n_u32(s, 16), 16807);
+	uint32x4_t b = vaddq_u32(
+		vandq_u32(vshlq_n_u32(u, 16), p),
+		vmulq_n_u32(vandq_u32(s, vdupq_n_u32(65535)), 16807)
+	);
+	uint32x4_t over = vreinterpretq_u32_s32(
+		vshrq_n_s32(vreinterpretq_s32_u32(b), 31)
+	);
+
+	/* b + c, minus 2^31 - 1 if b > 2^31 - 2 */
+	return vsubq_u32(vaddq_u32(b, vshrq_n_u32(u, 15)), vandq_u32(over, p));
+}
+
+/*!
+ * Fold 64-bit values modulo 2^31 - 1 so they fit in 32-bit.
+ */
+static uint32x2_t libhonoka__fold64_neon(uint64x2_t v)
+{
+	return vmovn_u64(vaddq_u64(
+		vandq_u64(v, vdupq_n_u64(2147483647)),
+		vshrq_n_u64(v, 31)
+	));
+}
+
+/*!
+ * Multiply 4 fully reduced keys by `m` modulo 2^31 - 1.
+ */
+static uint32x4_t libhonoka__v2_mulmod_neon(uint32x4_t s, uint32x4_t m)
+{
+	const uint32x4_t p = vdupq_n_u32(2147483647);
+
+	/* 2^31 = 1 in modulo 2^31 - 1 */
+	s = vcombine_u32(
+		libhonoka__fold64_neon(vmull_u32(vget_low_u32(s), vget_low_u32(m))),
+		libhonoka__fold64_neon(vmull_high_u32(s, m))
+	);
+	s = vaddq_u32(vandq_u32(s, p), vshrq_n_u32(s, 31));
+	return vaddq_u32(vandq_u32(s, p), vshrq_n_u32(s, 31));
+}
+
+/*!
+ * Extract the 2 keystream bytes of version 2 keys.
+ */
+static uint16x4_t libhonoka__v2_word_neon(uint32x4_t k)
+{
+	return vmovn_u32(vorrq_u32(
+		vandq_u32(vshrq_n_u32(k, 23), vdupq_n_u32(255)),
+		vandq_u32(vshrq_n_u32(k, 7), vdupq_n_u32(65280))
+	));
+}
+
+size_t libhonoka__v2_xor_neon(
+	unsigned int        *key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 8 lanes, 2 bytes each, in 2 registers */
+	unsigned int lanes[8];
+	unsigned int mul_val;
+	uint32x4_t s0, s1, vmul;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0 || !libhonoka__v2_lanes(*key, lanes, 8, &mul_val))
+		return 0;
+
+	s0 = vld1q_u32(&lanes[0]);
+	s1 = vld1q_u32(&lanes[4]);
+	vmul = vdupq_n_u32(mul_val);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		uint16x8_t ks = vcombine_u16(
+			libhonoka__v2_word_neon(libhonoka__v2_update_neon(s0)),
+			libhonoka__v2_word_neon(libhonoka__v2_update_neon(s1))
+		);
+
+		vst1q_u8(out, veorq_u8(vld1q_u8(in), vreinterpretq_u8_u16(ks)));
+		s0 = libhonoka__v2_mulmod_neon(s0, vmul);
+		s1 = libhonoka__v2_mulmod_neon(s1, vmul);
+	}
+
+	*key = vgetq_lane_u32(libhonoka__v2_update_neon(s0), 0);
+	return blocks << 4;
+}
+
+size_t libhonoka__lcg_xor_neon(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 16 LCG lanes, 1 byte each, in 4 registers */
+	uint32x4_t s[4], vmul, vadd;
+	int32x4_t shift;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_load_neon(*key, lcg, s, &vmul, &vadd);
+	shift = vdupq_n_s32(-(int) lcg->shift_val);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+		vst1q_u8(out, veorq_u8(
+			vld1q_u8(in),
+			libhonoka__lcg_next_neon(s, vmul, vadd, shift)
+		));
+
+	*key = vgetq_lane_u32(s[0], 0);
+	return blocks << 4;
+}
+
+size_t libhonoka__lcg2_xor_neon(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned int         *key2,
+	const libhonoka__lcg *lcg2,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 16 lanes of both LCGs, 1 byte each, in 4 registers each */
+	uint32x4_t s[4], t[4], vmul, vadd, vmul2, vadd2;
+	int32x4_t shift, shift2;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_load_neon(*key, lcg, s, &vmul, &vadd);
+	libhonoka__lcg_load_neon(*key2, lcg2, t, &vmul2, &vadd2);
+	shift = vdupq_n_s32(-(int) lcg->shift_val);
+	shift2 = vdupq_n_s32(-(int) lcg2->shift_val);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+		vst1q_u8(out, veorq_u8(
+			vld1q_u8(in),
+			veorq_u8(
+				libhonoka__lcg_next_neon(s, vmul, vadd, shift),
+				libhonoka__lcg_next_neon(t, vmul2, vadd2, shift2)
+			)
+		));
+
+	*key = vgetq_lane_u32(s[0], 0);
+	*key2 = vgetq_lane_u32(t[0], 0);
+	return blocks << 4;
+}
+
+size_t libhonoka__v5_decrypt_neon(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_neon */
+	uint32x4_t s[4], vmul, vadd;
+	int32x4_t shift;
+	uint8x16_t last;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_load_neon(*key, lcg, s, &vmul, &vadd);
+	shift = vdupq_n_s32(-(int) lcg->shift_val);
+	last = vdupq_n_u8(*chain);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		uint8x16_t cur = vld1q_u8(in);
+
+		/* Previous encrypted bytes are the input shifted by 1 byte */
+		vst1q_u8(out, veorq_u8(
+			veorq_u8(cur, vextq_u8(last, cur, 15)),
+			libhonoka__lcg_next_neon(s, vmul, vadd, shift)
+		));
+		last = cur;
+	}
+
+	*key = vgetq_lane_u32(s[0], 0);
+	*chain = vgetq_lane_u8(last, 15);
+	return blocks << 4;
+}
+
+size_t libhonoka__v5_encrypt_neon(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_neon */
+	uint32x4_t s[4], vmul, vadd;
+	int32x4_t shift;
+	uint8x16_t carry, zero;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_load_neon(*key, lcg, s, &vmul, &vadd);
+	shift = vdupq_n_s32(-(int) lcg->shift_val);
+	carry = vdupq_n_u8(*chain);
+	zero = vdupq_n_u8(0);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		uint8x16_t x = veorq_u8(
+			vld1q_u8(in),
+			libhonoka__lcg_next_neon(s, vmul, vadd, shift)
+		);
+
+		/* Prefix-XOR in log steps, then chain the previous block */
+		x = veorq_u8(x, vextq_u8(zero, x, 15));
+		x = veorq_u8(x, vextq_u8(zero, x, 14));
+		x = veorq_u8(x, vextq_u8(zero, x, 12));
+		x = veorq_u8(x, vextq_u8(zero, x, 8));
+		x = veorq_u8(x, carry);
+
+		vst1q_u8(out, x);
+		carry = vdupq_laneq_u8(x, 15);
+	}
+
+	*key = vgetq_lane_u32(s[0], 0);
+	*chain = vgetq_lane_u8(carry, 0);
+	return blocks << 4;
+}
+
+/* MD5 of one message per lane */
+#define LIBHONOKA_MD5_VEC uint32x4_t
+#define LIBHONOKA_MD5_LANES 4
+#define LIBHONOKA_MD5_LOAD(p) vld1q_u32(p)
+#define LIBHONOKA_MD5_STORE(p, x) vst1q_u32(p, x)
+#define LIBHONOKA_MD5_SET1(x) vdupq_n_u32(x)
+#define LIBHONOKA_MD5_ADD(x, y) vaddq_u32(x, y)
+#define LIBHONOKA_MD5_AND(x, y) vandq_u32(x, y)
+#define LIBHONOKA_MD5_OR(x, y) vorrq_u32(x, y)
+#define LIBHONOKA_MD5_XOR(x, y) veorq_u32(x, y)
+#define LIBHONOKA_MD5_ROTL(x, n) vsriq_n_u32(vshlq_n_u32(x, n), x, 32 - (n))
+#define LIBHONOKA_MD5_LESS(x, y) vcltq_u32(x, y)
+#define LIBHONOKA_MD5_FUNC libhonoka__md5_neon
+#include "honokamiku_md5_lanes.h"
+
+#endif /* LIBHONOKA_KERNEL_NEON */
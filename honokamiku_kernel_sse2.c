@@ -0,0 +1,474 @@
+/*!
+ * \file honokamiku_kernel_sse2.c
+ * SSE2 multi-lane decryption kernels
+ */
+
+#include <string.h>
+
+#include "honokamiku_internal.h"
+
+#ifdef LIBHONOKA_X86_SSE2
+
+#include <emmintrin.h>
+
+/*!
+ * 32-bit multiply of each lane (SSE2 only has 32x32=64 multiply).
+ */
+static __m128i libhonoka__mullo_sse2(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(
+		_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+		_mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))
+	);
+}
+
+/*!
+ * Extract the keystream byte of 4 registers of 4 LCG lanes, in order.
+ */
+static __m128i libhonoka__pack4_sse2(
+	__m128i s0, __m128i s1, __m128i s2, __m128i s3,
+	__m128i shift, __m128i mask
+)
+{
+	return _mm_packus_epi16(
+		_mm_packs_epi32(
+			_mm_and_si128(_mm_srl_epi32(s0, shift), mask),
+			_mm_and_si128(_mm_srl_epi32(s1, shift), mask)
+		),
+		_mm_packs_epi32(
+			_mm_and_si128(_mm_srl_epi32(s2, shift), mask),
+			_mm_and_si128(_mm_srl_epi32(s3, shift), mask)
+		)
+	);
+}
+
+/*!
+ * Byte-swap each 32-bit lane.
+ */
+static __m128i libhonoka__bswap32_sse2(__m128i x)
+{
+	x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+	x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+size_t libhonoka__v1_xor_sse2(
+	unsigned int        *key,
+	unsigned int         update_key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 4 keys, 4 bytes each */
+	__m128i k, step;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	k = _mm_setr_epi32(
+		(int) *key,
+		(int) (*key + update_key),
+		(int) (*key + update_key * 2),
+		(int) (*key + update_key * 3)
+	);
+	step = _mm_set1_epi32((int) (update_key * 4));
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *) in),
+			libhonoka__bswap32_sse2(k)
+		));
+		k = _mm_add_epi32(k, step);
+	}
+
+	*key += (unsigned int) (blocks << 2) * update_key;
+	return blocks << 4;
+}
+
+/*!
+ * Multiply each 16-bit lane value (upper 16 bits must be 0) by 16807.
+ */
+static __m128i libhonoka__mul16807_sse2(__m128i x)
+{
+	const __m128i k = _mm_set1_epi32(16807);
+
+	return _mm_or_si128(
+		_mm_mullo_epi16(x, k),
+		_mm_slli_epi32(_mm_mulhi_epu16(x, k), 16)
+	);
+}
+
+/*!
+ * Branch-free honokamiku_update_v2 of 4 fully reduced keys.
+ */
+static __m128i libhonoka__v2_update_sse2(__m128i s)
+{
+	const __m128i p = _mm_set1_epi32(2147483647);
+	__m128i u = libhonoka__mul16807_sse2(_mm_srli_epi32(s, 16));
+	__m128i b = _mm_add_epi32(
+		_mm_and_si128(_mm_slli_epi32(u, 16), p),
+		libhonoka__mul16807_sse2(_mm_and_si128(s, _mm_set1_epi32(65535)))
+	);
+
+	/* b + c, minus 2^31 - 1 if b > 2^31 - 2 */
+	return _mm_sub_epi32(
+		_mm_add_epi32(b, _mm_srli_epi32(u, 15)),
+		_mm_and_si128(_mm_srai_epi32(b, 31), p)
+	);
+}
+
+/*!
+ * Multiply 4 fully reduced keys by `m` modulo 2^31 - 1.
+ */
+static __m128i libhonoka__v2_mulmod_sse2(__m128i s, __m128i m)
+{
+	const __m128i p = _mm_set1_epi32(2147483647);
+	const __m128i p64 = _mm_set_epi32(0, 2147483647, 0, 2147483647);
+	__m128i even = _mm_mul_epu32(s, m);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(s, 32), m);
+
+	/* 2^31 = 1 in modulo 2^31 - 1. After the first fold it fits in 32-bit */
+	even = _mm_add_epi64(_mm_and_si128(even, p64), _mm_srli_epi64(even, 31));
+	odd = _mm_add_epi64(_mm_and_si128(odd, p64), _mm_srli_epi64(odd, 31));
+	s = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+	s = _mm_add_epi32(_mm_and_si128(s, p), _mm_srli_epi32(s, 31));
+	return _mm_add_epi32(_mm_and_si128(s, p), _mm_srli_epi32(s, 31));
+}
+
+/*!
+ * Extract the 2 keystream bytes of version 2 keys, sign-extended from 16-bit
+ * so that they survive _mm_packs_epi32.
+ */
+static __m128i libhonoka__v2_word_sse2(__m128i k)
+{
+	__m128i w = _mm_or_si128(
+		_mm_and_si128(_mm_srli_epi32(k, 23), _mm_set1_epi32(255)),
+		_mm_and_si128(_mm_srli_epi32(k, 7), _mm_set1_epi32(65280))
+	);
+
+	return _mm_srai_epi32(_mm_slli_epi32(w, 16), 16);
+}
+
+size_t libhonoka__v2_xor_sse2(
+	unsigned int        *key,
+	const unsigned char *in,
+	unsigned char       *out,
+	size_t               size
+)
+{
+	/* 8 lanes, 2 bytes each, in 2 registers */
+	unsigned int lanes[8];
+	unsigned int mul_val;
+	__m128i s0, s1, vmul;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0 || !libhonoka__v2_lanes(*key, lanes, 8, &mul_val))
+		return 0;
+
+	s0 = _mm_loadu_si128((const __m128i *) &lanes[0]);
+	s1 = _mm_loadu_si128((const __m128i *) &lanes[4]);
+	vmul = _mm_set1_epi32((int) mul_val);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		__m128i ks = _mm_packs_epi32(
+			libhonoka__v2_word_sse2(libhonoka__v2_update_sse2(s0)),
+			libhonoka__v2_word_sse2(libhonoka__v2_update_sse2(s1))
+		);
+
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *) in), ks
+		));
+		s0 = libhonoka__v2_mulmod_sse2(s0, vmul);
+		s1 = libhonoka__v2_mulmod_sse2(s1, vmul);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(libhonoka__v2_update_sse2(s0));
+	return blocks << 4;
+}
+
+size_t libhonoka__lcg_xor_sse2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 16 LCG lanes, 1 byte each, in 4 registers */
+	unsigned int lanes[16];
+	unsigned int mul_val, add_val;
+	__m128i s0, s1, s2, s3, vmul, vadd, mask, shift;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 16, &mul_val, &add_val);
+	s0 = _mm_loadu_si128((const __m128i *) &lanes[0]);
+	s1 = _mm_loadu_si128((const __m128i *) &lanes[4]);
+	s2 = _mm_loadu_si128((const __m128i *) &lanes[8]);
+	s3 = _mm_loadu_si128((const __m128i *) &lanes[12]);
+	vmul = _mm_set1_epi32((int) mul_val);
+	vadd = _mm_set1_epi32((int) add_val);
+	mask = _mm_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		__m128i ks = libhonoka__pack4_sse2(s0, s1, s2, s3, shift, mask);
+
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *) in), ks
+		));
+
+		s0 = _mm_add_epi32(libhonoka__mullo_sse2(s0, vmul), vadd);
+		s1 = _mm_add_epi32(libhonoka__mullo_sse2(s1, vmul), vadd);
+		s2 = _mm_add_epi32(libhonoka__mullo_sse2(s2, vmul), vadd);
+		s3 = _mm_add_epi32(libhonoka__mullo_sse2(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(s0);
+	return blocks << 4;
+}
+
+size_t libhonoka__lcg2_xor_sse2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned int         *key2,
+	const libhonoka__lcg *lcg2,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* 16 lanes of both LCGs, 1 byte each, in 4 registers each */
+	unsigned int lanes[16], lanes2[16];
+	unsigned int mul_val, add_val, mul_val2, add_val2;
+	__m128i s0, s1, s2, s3, t0, t1, t2, t3;
+	__m128i vmul, vadd, vmul2, vadd2, mask, shift, shift2, noshift;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 16, &mul_val, &add_val);
+	libhonoka__lcg_lanes(*key2, lcg2, lanes2, 16, &mul_val2, &add_val2);
+	s0 = _mm_loadu_si128((const __m128i *) &lanes[0]);
+	s1 = _mm_loadu_si128((const __m128i *) &lanes[4]);
+	s2 = _mm_loadu_si128((const __m128i *) &lanes[8]);
+	s3 = _mm_loadu_si128((const __m128i *) &lanes[12]);
+	t0 = _mm_loadu_si128((const __m128i *) &lanes2[0]);
+	t1 = _mm_loadu_si128((const __m128i *) &lanes2[4]);
+	t2 = _mm_loadu_si128((const __m128i *) &lanes2[8]);
+	t3 = _mm_loadu_si128((const __m128i *) &lanes2[12]);
+	vmul = _mm_set1_epi32((int) mul_val);
+	vadd = _mm_set1_epi32((int) add_val);
+	vmul2 = _mm_set1_epi32((int) mul_val2);
+	vadd2 = _mm_set1_epi32((int) add_val2);
+	mask = _mm_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	shift2 = _mm_cvtsi32_si128((int) lcg2->shift_val);
+	noshift = _mm_setzero_si128();
+
+#define LIBHONOKA_V6_KEY(s, t) _mm_xor_si128( \
+	_mm_srl_epi32(s, shift), _mm_srl_epi32(t, shift2))
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		/* Shift by 0 as the keys are combined already */
+		__m128i ks = libhonoka__pack4_sse2(
+			LIBHONOKA_V6_KEY(s0, t0), LIBHONOKA_V6_KEY(s1, t1),
+			LIBHONOKA_V6_KEY(s2, t2), LIBHONOKA_V6_KEY(s3, t3),
+			noshift, mask
+		);
+
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *) in), ks
+		));
+
+		s0 = _mm_add_epi32(libhonoka__mullo_sse2(s0, vmul), vadd);
+		s1 = _mm_add_epi32(libhonoka__mullo_sse2(s1, vmul), vadd);
+		s2 = _mm_add_epi32(libhonoka__mullo_sse2(s2, vmul), vadd);
+		s3 = _mm_add_epi32(libhonoka__mullo_sse2(s3, vmul), vadd);
+		t0 = _mm_add_epi32(libhonoka__mullo_sse2(t0, vmul2), vadd2);
+		t1 = _mm_add_epi32(libhonoka__mullo_sse2(t1, vmul2), vadd2);
+		t2 = _mm_add_epi32(libhonoka__mullo_sse2(t2, vmul2), vadd2);
+		t3 = _mm_add_epi32(libhonoka__mullo_sse2(t3, vmul2), vadd2);
+	}
+
+#undef LIBHONOKA_V6_KEY
+
+	*key = (unsigned int) _mm_cvtsi128_si32(s0);
+	*key2 = (unsigned int) _mm_cvtsi128_si32(t0);
+	return blocks << 4;
+}
+
+size_t libhonoka__v5_decrypt_sse2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_sse2 */
+	unsigned int lanes[16];
+	unsigned int mul_val, add_val;
+	__m128i s0, s1, s2, s3, vmul, vadd, mask, shift, carry;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 16, &mul_val, &add_val);
+	s0 = _mm_loadu_si128((const __m128i *) &lanes[0]);
+	s1 = _mm_loadu_si128((const __m128i *) &lanes[4]);
+	s2 = _mm_loadu_si128((const __m128i *) &lanes[8]);
+	s3 = _mm_loadu_si128((const __m128i *) &lanes[12]);
+	vmul = _mm_set1_epi32((int) mul_val);
+	vadd = _mm_set1_epi32((int) add_val);
+	mask = _mm_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	/* Previous encrypted byte in the first byte */
+	carry = _mm_cvtsi32_si128(*chain);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		__m128i ks = libhonoka__pack4_sse2(s0, s1, s2, s3, shift, mask);
+		__m128i cur = _mm_loadu_si128((const __m128i *) in);
+		/* The encrypted bytes, shifted by 1 byte. Kept in register, so */
+		/* `in` can be the same as `out` */
+		__m128i prev = _mm_or_si128(_mm_slli_si128(cur, 1), carry);
+
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(
+			_mm_xor_si128(cur, prev), ks
+		));
+		carry = _mm_srli_si128(cur, 15);
+
+		s0 = _mm_add_epi32(libhonoka__mullo_sse2(s0, vmul), vadd);
+		s1 = _mm_add_epi32(libhonoka__mullo_sse2(s1, vmul), vadd);
+		s2 = _mm_add_epi32(libhonoka__mullo_sse2(s2, vmul), vadd);
+		s3 = _mm_add_epi32(libhonoka__mullo_sse2(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(s0);
+	*chain = (unsigned char) _mm_cvtsi128_si32(carry);
+	return blocks << 4;
+}
+
+size_t libhonoka__v5_encrypt_sse2(
+	unsigned int         *key,
+	const libhonoka__lcg *lcg,
+	unsigned char        *chain,
+	const unsigned char  *in,
+	unsigned char        *out,
+	size_t                size
+)
+{
+	/* Same lanes as libhonoka__lcg_xor_sse2 */
+	unsigned int lanes[16];
+	unsigned int mul_val, add_val;
+	__m128i s0, s1, s2, s3, vmul, vadd, mask, shift, carry;
+	size_t blocks = size >> 4, i;
+
+	if (blocks == 0)
+		return 0;
+
+	libhonoka__lcg_lanes(*key, lcg, lanes, 16, &mul_val, &add_val);
+	s0 = _mm_loadu_si128((const __m128i *) &lanes[0]);
+	s1 = _mm_loadu_si128((const __m128i *) &lanes[4]);
+	s2 = _mm_loadu_si128((const __m128i *) &lanes[8]);
+	s3 = _mm_loadu_si128((const __m128i *) &lanes[12]);
+	vmul = _mm_set1_epi32((int) mul_val);
+	vadd = _mm_set1_epi32((int) add_val);
+	mask = _mm_set1_epi32(255);
+	shift = _mm_cvtsi32_si128((int) lcg->shift_val);
+	/* Previous encrypted byte in all bytes */
+	carry = _mm_set1_epi8((char) *chain);
+
+	for (i = 0; i < blocks; i++, in += 16, out += 16)
+	{
+		__m128i x = _mm_xor_si128(
+			_mm_loadu_si128((const __m128i *) in),
+			libhonoka__pack4_sse2(s0, s1, s2, s3, shift, mask)
+		);
+
+		/* Encrypted byte is XOR of all bytes so far: prefix XOR them */
+		x = _mm_xor_si128(x, _mm_slli_si128(x, 1));
+		x = _mm_xor_si128(x, _mm_slli_si128(x, 2));
+		x = _mm_xor_si128(x, _mm_slli_si128(x, 4));
+		x = _mm_xor_si128(x, _mm_slli_si128(x, 8));
+		x = _mm_xor_si128(x, carry);
+		_mm_storeu_si128((__m128i *) out, x);
+
+		/* Broadcast the last byte */
+		carry = _mm_srli_si128(x, 15);
+		carry = _mm_unpacklo_epi8(carry, carry);
+		carry = _mm_unpacklo_epi16(carry, carry);
+		carry = _mm_shuffle_epi32(carry, 0);
+
+		s0 = _mm_add_epi32(libhonoka__mullo_sse2(s0, vmul), vadd);
+		s1 = _mm_add_epi32(libhonoka__mullo_sse2(s1, vmul), vadd);
+		s2 = _mm_add_epi32(libhonoka__mullo_sse2(s2, vmul), vadd);
+		s3 = _mm_add_epi32(libhonoka__mullo_sse2(s3, vmul), vadd);
+	}
+
+	*key = (unsigned int) _mm_cvtsi128_si32(s0);
+	*chain = (unsigned char) _mm_cvtsi128_si32(carry);
+	return blocks << 4;
+}
+
+void libhonoka__stream_copy_sse2(const unsigned char *in, unsigned char *out, size_t size)
+{
+	/* Non-temporal stores must be aligned */
+	size_t head = (size_t) (16 - ((size_t) out & 15)) & 15;
+	size_t i;
+
+	if (head > size) head = size;
+	memcpy(out, in, head);
+
+	for (i = head; i + 64 <= size; i += 64)
+	{
+		__m128i x0 = _mm_loadu_si128((const __m128i *) (in + i));
+		__m128i x1 = _mm_loadu_si128((const __m128i *) (in + i + 16));
+		__m128i x2 = _mm_loadu_si128((const __m128i *) (in + i + 32));
+		__m128i x3 = _mm_loadu_si128((const __m128i *) (in + i + 48));
+
+		_mm_stream_si128((__m128i *) (out + i), x0);
+		_mm_stream_si128((__m128i *) (out + i + 16), x1);
+		_mm_stream_si128((__m128i *) (out + i + 32), x2);
+		_mm_stream_si128((__m128i *) (out + i + 48), x3);
+	}
+
+	for (; i + 16 <= size; i += 16)
+		_mm_stream_si128((__m128i *) (out + i), _mm_loadu_si128((const __m128i *) (in + i)));
+
+	/* Make the stores visible before returning */
+	_mm_sfence();
+	memcpy(out + i, in + i, size - i);
+}
+
+/* MD5 of one message per lane */
+#define LIBHONOKA_MD5_VEC __m128i
+#define LIBHONOKA_MD5_LANES 4
+#define LIBHONOKA_MD5_LOAD(p) _mm_loadu_si128((const __m128i *) (p))
+#define LIBHONOKA_MD5_STORE(p, x) _mm_storeu_si128((__m128i *) (p), x)
+#define LIBHONOKA_MD5_SET1(x) _mm_set1_epi32((int) (x))
+#define LIBHONOKA_MD5_ADD(x, y) _mm_add_epi32(x, y)
+#define LIBHONOKA_MD5_AND(x, y) _mm_and_si128(x, y)
+#define LIBHONOKA_MD5_OR(x, y) _mm_or_si128(x, y)
+#define LIBHONOKA_MD5_XOR(x, y) _mm_xor_si128(x, y)
+#define LIBHONOKA_MD5_ROTL(x, n) _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+#define LIBHONOKA_MD5_LESS(x, y) _mm_cmplt_epi32(x, y)
+#define LIBHONOKA_MD5_FUNC libhonoka__md5_sse2
+#include "honokamiku_md5_lanes.h"
+
+#endif /* LIBHONOKA_X86_SSE2 */
@@ -107,3 +107,105 @@ const lcg_keys lcg_key_tables[] = {
 	{214013, 2531011, 24},
 	{65793, 4282663, 8}
 };
+
+/*!
+ * Linear Congruential Generator jump coefficients
+ */
+typedef struct lcg_jump
+{
+	unsigned int multipler;
+	unsigned int increment;
+} lcg_jump;
+
+/*!
+ * Linear Congruential Generator jump tables. Entry `i` advances the
+ * respective lcg_key_tables generator by 2^i steps at once.
+ */
+static const lcg_jump lcg_jump_tables[4][32] = {
+	{
+		{1103515245u, 12345u}, {3265436265u, 3554416254u},
+		{3993403153u, 3596950572u}, {3487424289u, 3441282840u},
+		{1601471041u, 1695770928u}, {2335052929u, 1680572000u},
+		{1979738369u, 422948032u}, {387043841u, 3058047360u},
+		{3194463233u, 519516928u}, {3722397697u, 530212352u},
+		{1073647617u, 2246364160u}, {2432507905u, 646551552u},
+		{1710899201u, 3088265216u}, {3690233857u, 472276992u},
+		{4159242241u, 3897344000u}, {4023517185u, 2425978880u},
+		{3752067073u, 556990464u}, {3209166849u, 1113980928u},
+		{2123366401u, 2227961856u}, {4246732801u, 160956416u},
+		{4198498305u, 321912832u}, {4102029313u, 643825664u},
+		{3909091329u, 1287651328u}, {3523215361u, 2575302656u},
+		{2751463425u, 855638016u}, {1207959553u, 1711276032u},
+		{2415919105u, 3422552064u}, {536870913u, 2550136832u},
+		{1073741825u, 805306368u}, {2147483649u, 1610612736u},
+		{1u, 3221225472u}, {1u, 2147483648u}
+	},
+	{
+		{22695477u, 1u}, {2133350137u, 22695478u},
+		{1499217457u, 2867233980u}, {3562259809u, 1153135800u},
+		{1024749249u, 3359393392u}, {2014473601u, 3568402656u},
+		{2231048961u, 2781008320u}, {4274992641u, 2128929664u},
+		{1560439809u, 977716992u}, {2543114241u, 3733032448u},
+		{2775166977u, 617815040u}, {601055233u, 3907401728u},
+		{2879832065u, 1322020864u}, {3880615937u, 2442715136u},
+		{245039105u, 4080123904u}, {490078209u, 644055040u},
+		{980156417u, 1288110080u}, {1960312833u, 2576220160u},
+		{3920625665u, 857473024u}, {3546284033u, 1714946048u},
+		{2797600769u, 3429892096u}, {1300234241u, 2564816896u},
+		{2600468481u, 834666496u}, {905969665u, 1669332992u},
+		{1811939329u, 3338665984u}, {3623878657u, 2382364672u},
+		{2952790017u, 469762048u}, {1610612737u, 939524096u},
+		{3221225473u, 1879048192u}, {2147483649u, 3758096384u},
+		{1u, 3221225472u}, {1u, 2147483648u}
+	},
+	{
+		{214013u, 2531011u}, {2851891209u, 505908858u},
+		{3724496977u, 159719620u}, {4103125409u, 2115878600u},
+		{1136269121u, 1043415696u}, {3532701313u, 2186156320u},
+		{2195963137u, 2219737664u}, {3209722369u, 4253435008u},
+		{4173657089u, 3752954112u}, {2048518145u, 3656847872u},
+		{376688641u, 1581130752u}, {3051855873u, 1706838016u},
+		{2412724225u, 1886949376u}, {2946400257u, 1961959424u},
+		{2671575041u, 971128832u}, {1048182785u, 3015999488u},
+		{2096365569u, 1737031680u}, {4192731137u, 3474063360u},
+		{4090494977u, 2653159424u}, {3886022657u, 1011351552u},
+		{3477078017u, 2022703104u}, {2659188737u, 4045406208u},
+		{1023410177u, 3795845120u}, {2046820353u, 3296722944u},
+		{4093640705u, 2298478592u}, {3892314113u, 301989888u},
+		{3489660929u, 603979776u}, {2684354561u, 1207959552u},
+		{1073741825u, 2415919104u}, {2147483649u, 536870912u},
+		{1u, 1073741824u}, {1u, 2147483648u}
+	},
+	{
+		{65793u, 4282663u}, {33751553u, 2600655182u},
+		{269091841u, 1671581340u}, {1881409537u, 580324664u},
+		{545787905u, 1501026928u}, {1108353025u, 1008121056u},
+		{2283814913u, 1556703680u}, {541097985u, 1275253632u},
+		{2155937793u, 3787826944u}, {16908289u, 3934998016u},
+		{33816577u, 1897307136u}, {67633153u, 1378695168u},
+		{135266305u, 1683648512u}, {270532609u, 3367297024u},
+		{541065217u, 2439626752u}, {1082130433u, 584286208u},
+		{2164260865u, 1168572416u}, {33554433u, 2337144832u},
+		{67108865u, 379322368u}, {134217729u, 758644736u},
+		{268435457u, 1517289472u}, {536870913u, 3034578944u},
+		{1073741825u, 1774190592u}, {2147483649u, 3548381184u},
+		{1u, 2801795072u}, {1u, 1308622848u},
+		{1u, 2617245696u}, {1u, 939524096u},
+		{1u, 1879048192u}, {1u, 3758096384u},
+		{1u, 3221225472u}, {1u, 2147483648u}
+	}
+};
+
+/*!
+ * Version 2 jump tables. Entry `i` is 16807^(2^i) mod (2^31 - 1)
+ */
+static const unsigned int v2_jump_tables[31] = {
+	16807u		,282475249u	,984943658u	,1457850878u,
+	1137522503u	,1636807826u,685118024u	,515204530u	,
+	897054849u	,2038299453u,1836275591u,349037107u	,
+	149796865u	,1186652285u,2106880871u,877809922u	,
+	1682791109u	,1900685356u,2080563572u,612544882u	,
+	1295048709u	,1987420232u,868966365u	,1331238991u,
+	1550655590u	,766698560u	,1154667137u,901595110u	,
+	1008653149u	,1821072732u,2147466840u
+};
@@ -0,0 +1,360 @@
+/*!
+ * \file honokamiku_keycache.c
+ * Keystream cache of version 3 LCG keys
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define HONOKAMIKU_DECRYPTER_CORE
+
+#include "honokamiku_decrypter.h"
+#include "honokamiku_internal.h"
+
+/*
+ * The cache can be shared between processes, so the slots are claimed and
+ * filled with the atomic operations of honokamiku_internal.h.
+ */
+
+/* "HKC1" */
+#define LIBHONOKA_KEYCACHE_MAGIC 0x31434B48U
+/* Keystream is filled in this granularity */
+#define LIBHONOKA_KEYCACHE_PAGE 65536
+
+/* Slot states */
+#define LIBHONOKA_SLOT_FREE     0
+#define LIBHONOKA_SLOT_READY    2
+/* Times a slot claimed for same keys is checked before giving up on it, */
+/* in case the process claiming it died */
+#define LIBHONOKA_SLOT_SPINS    1048576
+
+/*!
+ * Keystream cache memory header, followed by the slots then the keystream
+ * of each slot. Everything is addressed relative to the header, so the
+ * memory can be mapped at different addresses.
+ */
+typedef struct libhonoka__keycache_header
+{
+	unsigned int magic;       /* LIBHONOKA_KEYCACHE_MAGIC once initialized */
+	unsigned int slot_count;
+	unsigned int stream_size; /* Keystream bytes of each slot */
+	unsigned int reserved;
+} libhonoka__keycache_header;
+
+typedef struct libhonoka__keycache_slot
+{
+	volatile unsigned int state;  /* LIBHONOKA_SLOT_* */
+	volatile unsigned int tag;    /* libhonoka__keycache_tag() once claimed */
+	volatile unsigned int lock;   /* 1 while the keystream is extended. Stays */
+	                              /* 1 if the extending process dies */
+	volatile unsigned int filled; /* Keystream bytes available */
+	unsigned int init_key;
+	unsigned int mul_val;
+	unsigned int add_val;
+	unsigned int shift_val;
+} libhonoka__keycache_slot;
+
+struct honokamiku_keycache
+{
+	libhonoka__keycache_header *header;
+	int                         owned; /* Allocated by honokamiku_keycache_create */
+};
+
+/* Largest cached keystream per slot, and most slots */
+#define LIBHONOKA_KEYCACHE_MAX_STREAM 0x40000000
+#define LIBHONOKA_KEYCACHE_MAX_SLOTS  65536
+
+static size_t libhonoka__keycache_stream_size(size_t stream_size)
+{
+	return (stream_size + LIBHONOKA_KEYCACHE_PAGE - 1) & ~((size_t) LIBHONOKA_KEYCACHE_PAGE - 1);
+}
+
+size_t honokamiku_keycache_size(size_t slot_count, size_t stream_size)
+{
+	size_t head_size = sizeof(libhonoka__keycache_header);
+	size_t slot_max;
+
+	/* Rounding up larger sizes can wrap */
+	if (slot_count == 0 || stream_size > LIBHONOKA_KEYCACHE_MAX_STREAM)
+		return 0;
+
+	stream_size = libhonoka__keycache_stream_size(stream_size);
+
+	/* Memory size doesn't fit in size_t (32-bit targets) */
+	slot_max = ((size_t) -1 - head_size) / slot_count;
+	if (slot_max < sizeof(libhonoka__keycache_slot) || stream_size > slot_max - sizeof(libhonoka__keycache_slot))
+		return 0;
+
+	return head_size + slot_count * (sizeof(libhonoka__keycache_slot) + stream_size);
+}
+
+honokamiku_keycache *honokamiku_keycache_init(
+	void   *memory,
+	size_t  memory_size,
+	size_t  slot_count,
+	size_t  stream_size
+)
+{
+	libhonoka__keycache_header *header = (libhonoka__keycache_header *) memory;
+	size_t needed_size = honokamiku_keycache_size(slot_count, stream_size);
+	honokamiku_keycache *cache;
+
+	if (
+		memory == NULL ||
+		slot_count > LIBHONOKA_KEYCACHE_MAX_SLOTS ||
+		needed_size == 0 ||
+		memory_size < needed_size
+	)
+		return NULL;
+
+	stream_size = libhonoka__keycache_stream_size(stream_size);
+
+	if (header->magic == LIBHONOKA_KEYCACHE_MAGIC)
+	{
+		/* Existing cache, maybe from other process */
+		if (header->slot_count != slot_count || header->stream_size != stream_size)
+			return NULL;
+	}
+	else
+	{
+		/* Zeroed memory is an empty cache. Processes initializing same */
+		/* memory at the same time write the same values */
+		header->slot_count = (unsigned int) slot_count;
+		header->stream_size = (unsigned int) stream_size;
+		header->reserved = 0;
+		libhonoka__store(&header->magic, LIBHONOKA_KEYCACHE_MAGIC);
+	}
+
+	cache = (honokamiku_keycache *) malloc(sizeof(honokamiku_keycache));
+	if (cache == NULL) return NULL;
+
+	cache->header = header;
+	cache->owned = 0;
+	return cache;
+}
+
+honokamiku_keycache *honokamiku_keycache_create(size_t slot_count, size_t stream_size)
+{
+	size_t memory_size = honokamiku_keycache_size(slot_count, stream_size);
+	void *memory;
+	honokamiku_keycache *cache;
+
+	if (memory_size == 0) return NULL;
+
+	memory = calloc(1, memory_size);
+	if (memory == NULL) return NULL;
+
+	cache = honokamiku_keycache_init(memory, memory_size, slot_count, stream_size);
+	if (cache == NULL)
+	{
+		free(memory);
+		return NULL;
+	}
+
+	cache->owned = 1;
+	return cache;
+}
+
+void honokamiku_keycache_free(honokamiku_keycache *cache)
+{
+	if (cache == NULL) return;
+
+	if (cache->owned)
+		free(cache->header);
+
+	free(cache);
+}
+
+static libhonoka__keycache_slot *libhonoka__keycache_slots(const honokamiku_keycache *cache)
+{
+	return (libhonoka__keycache_slot *) (cache->header + 1);
+}
+
+static unsigned char *libhonoka__keycache_stream(const honokamiku_keycache *cache, size_t i)
+{
+	return (unsigned char *) (libhonoka__keycache_slots(cache) + cache->header->slot_count) +
+	       i * cache->header->stream_size;
+}
+
+/*!
+ * Nonzero hash of the decrypter context keys. Slots are claimed by setting
+ * it, so other threads know which keys are being written to the slot.
+ */
+static unsigned int libhonoka__keycache_tag(const honokamiku_context *dctx)
+{
+	unsigned int tag = dctx->init_key * 2654435761U;
+
+	tag ^= dctx->mul_val + (dctx->add_val << 8) + dctx->shift_val;
+	return tag | 1;
+}
+
+/*!
+ * Check if slot claimed with same tag holds the decrypter context keys,
+ * waiting for its keys to be written. Returns 1 if it does, 0 if it holds
+ * other keys with same tag, or -1 if its keys are never written.
+ */
+static int libhonoka__keycache_match(libhonoka__keycache_slot *slot, const honokamiku_context *dctx)
+{
+	long spins;
+
+	for (spins = 0; libhonoka__load(&slot->state) != LIBHONOKA_SLOT_READY; spins++)
+		if (spins == LIBHONOKA_SLOT_SPINS)
+			return -1;
+
+	return
+		slot->init_key == dctx->init_key &&
+		slot->mul_val == dctx->mul_val &&
+		slot->add_val == dctx->add_val &&
+		slot->shift_val == dctx->shift_val;
+}
+
+/*!
+ * Find the slot of the decrypter context keys, or claim a free one for it.
+ * Returns the slot index, or -1 if the cache is full.
+ */
+static long libhonoka__keycache_find(honokamiku_keycache *cache, const honokamiku_context *dctx)
+{
+	libhonoka__keycache_slot *slots = libhonoka__keycache_slots(cache);
+	size_t slot_count = cache->header->slot_count, i;
+	unsigned int tag = libhonoka__keycache_tag(dctx);
+
+	/* Slots are claimed in order, so slots after a free one are free too */
+	for (i = 0; i < slot_count; i++)
+	{
+		unsigned int slot_tag = libhonoka__load(&slots[i].tag);
+		int match;
+
+		if (slot_tag == 0)
+		{
+			if (libhonoka__cas(&slots[i].tag, 0, tag))
+			{
+				/* Claimed. Other threads with same keys wait for READY */
+				slots[i].init_key = dctx->init_key;
+				slots[i].mul_val = dctx->mul_val;
+				slots[i].add_val = dctx->add_val;
+				slots[i].shift_val = dctx->shift_val;
+				libhonoka__store(&slots[i].state, LIBHONOKA_SLOT_READY);
+				return (long) i;
+			}
+
+			/* Someone else claimed it first, maybe for same keys */
+			slot_tag = libhonoka__load(&slots[i].tag);
+		}
+
+		if (slot_tag != tag)
+			continue;
+
+		match = libhonoka__keycache_match(&slots[i], dctx);
+		if (match != 0)
+			return match > 0 ? (long) i : -1;
+	}
+
+	return -1;
+}
+
+/*!
+ * Make sure keystream up to `end` is cached, if nobody else is extending
+ * it at the moment. Returns the amount of keystream bytes available.
+ */
+static size_t libhonoka__keycache_fill(
+	honokamiku_keycache      *cache,
+	size_t                    i,
+	const honokamiku_context *dctx,
+	size_t                    end
+)
+{
+	libhonoka__keycache_slot *slot = &libhonoka__keycache_slots(cache)[i];
+	size_t filled = libhonoka__load(&slot->filled);
+
+	if (filled >= end || !libhonoka__cas(&slot->lock, 0, 1))
+		return filled;
+
+	filled = libhonoka__load(&slot->filled);
+	if (filled < end)
+	{
+		honokamiku_context tmp = *dctx;
+		size_t new_filled = (end + LIBHONOKA_KEYCACHE_PAGE - 1) & ~((size_t) LIBHONOKA_KEYCACHE_PAGE - 1);
+
+		if (new_filled > cache->header->stream_size)
+			new_filled = cache->header->stream_size;
+
+		honokamiku_jump_offset(&tmp, (unsigned int) filled);
+		honokamiku_keystream(&tmp, libhonoka__keycache_stream(cache, i) + filled, new_filled - filled);
+
+		filled = new_filled;
+		libhonoka__store(&slot->filled, (unsigned int) filled);
+	}
+
+	libhonoka__store(&slot->lock, 0);
+	return filled;
+}
+
+/*!
+ * XOR `size` bytes of `key` into `buffer`, a word at a time.
+ */
+static void libhonoka__xor_buffer(unsigned char *buffer, const unsigned char *key, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i + sizeof(size_t) <= size; i += sizeof(size_t))
+	{
+		size_t a, b;
+
+		memcpy(&a, buffer + i, sizeof(size_t));
+		memcpy(&b, key + i, sizeof(size_t));
+		a ^= b;
+		memcpy(buffer + i, &a, sizeof(size_t));
+	}
+
+	for (; i < size; i++)
+		buffer[i] ^= key[i];
+}
+
+void honokamiku_decrypt_block_cached(
+	honokamiku_keycache *cache,
+	honokamiku_context  *dctx,
+	void                *buffer,
+	size_t               buffer_size
+)
+{
+	unsigned char *file_buffer = (unsigned char *) buffer;
+
+	if (
+		cache != NULL &&
+		buffer_size > 0 &&
+		dctx->v3_initialized &&
+		/* Version 4 keys differ per file name, so caching them is useless */
+		dctx->dm == honokamiku_decrypt_version3 &&
+		dctx->pos < cache->header->stream_size
+	)
+	{
+		long i = libhonoka__keycache_find(cache, dctx);
+
+		if (i >= 0)
+		{
+			size_t end = dctx->pos + buffer_size;
+			size_t filled;
+
+			if (end > cache->header->stream_size)
+				end = cache->header->stream_size;
+
+			filled = libhonoka__keycache_fill(cache, (size_t) i, dctx, end);
+			if (filled > dctx->pos)
+			{
+				size_t size = (filled < end ? filled : end) - dctx->pos;
+
+				libhonoka__xor_buffer(
+					file_buffer,
+					libhonoka__keycache_stream(cache, (size_t) i) + dctx->pos,
+					size
+				);
+				honokamiku_jump_offset(dctx, dctx->pos + (unsigned int) size);
+				file_buffer += size;
+				buffer_size -= size;
+			}
+		}
+	}
+
+	/* Past the cached keystream, or not cacheable */
+	honokamiku_decrypt_block(dctx, file_buffer, buffer_size);
+}
@@ -0,0 +1,158 @@
+/*!
+ * \file honokamiku_md5.c
+ * MD5 of many short messages at once, one message per SIMD lane
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "honokamiku_internal.h"
+#include "md5.h"
+
+/*!
+ * Longest padded message hashed by the kernels, in 64-byte blocks. Longer
+ * messages (over 247 bytes) are hashed one by one.
+ */
+#define LIBHONOKA_MD5_MAX_BLOCKS 4
+/*!
+ * Most lanes of the kernels.
+ */
+#define LIBHONOKA_MD5_MAX_LANES 16
+
+static void libhonoka__md5_one(const libhonoka__md5_message *message, unsigned char *digest)
+{
+	MD5_CTX mctx;
+
+	MD5Init(&mctx);
+	MD5Update(&mctx, (const unsigned char *) message->prefix, (unsigned int) message->prefix_size);
+	MD5Update(&mctx, (const unsigned char *) message->name, (unsigned int) message->name_size);
+	MD5Final(&mctx);
+	memcpy(digest, mctx.digest, 16);
+}
+
+/*!
+ * Pad message into lane `lane` of the interleaved message words. Returns
+ * the amount of blocks.
+ */
+static unsigned int libhonoka__md5_pad(
+	const libhonoka__md5_message *message,
+	unsigned int                 *words,
+	size_t                        lanes,
+	size_t                        lane
+)
+{
+	unsigned char block[LIBHONOKA_MD5_MAX_BLOCKS * 64];
+	size_t size = message->prefix_size + message->name_size;
+	size_t blocks = (size + 8) / 64 + 1;
+	size_t i;
+
+	memcpy(block, message->prefix, message->prefix_size);
+	memcpy(block + message->prefix_size, message->name, message->name_size);
+	block[size] = 0x80;
+	block[size + 1] = block[size + 2] = block[size + 3] = 0;
+
+	/* Message and the 0x80 byte, then zeros up to the length. The kernels */
+	/* assume little endian, so the words are copied as is */
+	for (i = 0; i <= size / 4; i++)
+		memcpy(&words[i * lanes + lane], block + i * 4, 4);
+	for (; i < blocks * 16 - 2; i++)
+		words[i * lanes + lane] = 0;
+
+	/* Message length in bits, 64-bit little endian */
+	words[i * lanes + lane] = (unsigned int) (size << 3);
+	words[(i + 1) * lanes + lane] = (unsigned int) (size >> 29);
+
+	return (unsigned int) blocks;
+}
+
+/*!
+ * Hash the messages padded into the first `used` lanes and store their
+ * digests.
+ */
+static void libhonoka__md5_lanes(
+	const libhonoka__kernels *kernels,
+	const unsigned int       *words,
+	unsigned int             *block_counts,
+	size_t                    block_max,
+	const size_t             *index,
+	size_t                    used,
+	unsigned char            *digests
+)
+{
+	unsigned int state[4 * LIBHONOKA_MD5_MAX_LANES];
+	size_t lanes = kernels->md5_lanes, i, j;
+
+	for (i = 0; i < lanes; i++)
+	{
+		state[i] = 0x67452301U;
+		state[lanes + i] = 0xEFCDAB89U;
+		state[lanes * 2 + i] = 0x98BADCFEU;
+		state[lanes * 3 + i] = 0x10325476U;
+
+		/* Unused lanes keep their state */
+		if (i >= used)
+			block_counts[i] = 0;
+	}
+
+	kernels->md5(words, block_counts, block_max, state);
+
+	for (i = 0; i < used; i++)
+	{
+		unsigned char *digest = digests + index[i] * 16;
+
+		/* Little endian, same as the message words */
+		for (j = 0; j < 4; j++)
+			memcpy(digest + j * 4, &state[j * lanes + i], 4);
+	}
+}
+
+void libhonoka__md5_many(
+	const libhonoka__md5_message *messages,
+	size_t                        count,
+	unsigned char                *digests
+)
+{
+	const libhonoka__kernels *kernels;
+	unsigned int words[LIBHONOKA_MD5_MAX_BLOCKS * 16 * LIBHONOKA_MD5_MAX_LANES];
+	unsigned int block_counts[LIBHONOKA_MD5_MAX_LANES];
+	size_t index[LIBHONOKA_MD5_MAX_LANES];
+	size_t lanes, used = 0, block_max = 0, i;
+
+	/* A lone message is faster without the lanes */
+	if (count == 1)
+	{
+		libhonoka__md5_one(messages, digests);
+		return;
+	}
+
+	kernels = libhonoka__get_md5_kernels(count);
+	lanes = kernels->md5_lanes;
+
+	for (i = 0; i < count; i++)
+	{
+		const libhonoka__md5_message *message = &messages[i];
+
+		if (
+			kernels->md5 == NULL ||
+			message->prefix_size + message->name_size + 9 > LIBHONOKA_MD5_MAX_BLOCKS * 64
+		)
+		{
+			libhonoka__md5_one(message, digests + i * 16);
+			continue;
+		}
+
+		index[used] = i;
+		block_counts[used] = libhonoka__md5_pad(message, words, lanes, used);
+		if (block_counts[used] > block_max)
+			block_max = block_counts[used];
+
+		if (++used == lanes)
+		{
+			libhonoka__md5_lanes(kernels, words, block_counts, block_max, index, used, digests);
+			used = block_max = 0;
+		}
+	}
+
+	if (used > 0)
+		libhonoka__md5_lanes(kernels, words, block_counts, block_max, index, used, digests);
+}
@@ -0,0 +1,155 @@
+/*!
+ * \file honokamiku_md5_lanes.h
+ * Multi-lane MD5 transform, hashing one message per SIMD lane.
+ *
+ * Included by the kernel files after defining the vector operations:
+ * - `LIBHONOKA_MD5_VEC`: vector type of 32-bit lanes
+ * - `LIBHONOKA_MD5_LANES`: amount of lanes
+ * - `LIBHONOKA_MD5_LOAD(p)` and `LIBHONOKA_MD5_STORE(p, x)`: unaligned load
+ *   and store
+ * - `LIBHONOKA_MD5_SET1(x)`: broadcast 32-bit value
+ * - `LIBHONOKA_MD5_ADD`, `LIBHONOKA_MD5_AND`, `LIBHONOKA_MD5_OR`,
+ *   `LIBHONOKA_MD5_XOR`: lane-wise operations
+ * - `LIBHONOKA_MD5_ROTL(x, n)`: rotate lanes left by constant `n`
+ * - `LIBHONOKA_MD5_LESS(x, y)`: all bits set in lanes where `x < y`
+ * - `LIBHONOKA_MD5_FUNC`: name of the kernel function
+ */
+
+#define LIBHONOKA_MD5_F(b, c, d) \
+	LIBHONOKA_MD5_XOR(d, LIBHONOKA_MD5_AND(b, LIBHONOKA_MD5_XOR(c, d)))
+#define LIBHONOKA_MD5_G(b, c, d) \
+	LIBHONOKA_MD5_XOR(c, LIBHONOKA_MD5_AND(d, LIBHONOKA_MD5_XOR(b, c)))
+#define LIBHONOKA_MD5_H(b, c, d) \
+	LIBHONOKA_MD5_XOR(LIBHONOKA_MD5_XOR(b, c), d)
+#define LIBHONOKA_MD5_I(b, c, d) \
+	LIBHONOKA_MD5_XOR(c, LIBHONOKA_MD5_OR(b, LIBHONOKA_MD5_XOR(d, ones)))
+
+#define LIBHONOKA_MD5_STEP(f, a, b, c, d, x, t, s) \
+	a = LIBHONOKA_MD5_ADD(a, LIBHONOKA_MD5_ADD( \
+		f(b, c, d), \
+		LIBHONOKA_MD5_ADD(x, LIBHONOKA_MD5_SET1(t)) \
+	)); \
+	a = LIBHONOKA_MD5_ADD(LIBHONOKA_MD5_ROTL(a, s), b);
+
+/*!
+ * Hash blocks of `LIBHONOKA_MD5_LANES` messages. `words` holds the padded
+ * messages interleaved: word `w` of block `b` of lane `l` is at
+ * `words[(b * 16 + w) * LIBHONOKA_MD5_LANES + l]`. Lane `l` has
+ * `block_counts[l]` blocks, and its state is
+ * `state[i * LIBHONOKA_MD5_LANES + l]`, `i` from 0 to 3.
+ */
+void LIBHONOKA_MD5_FUNC(
+	const unsigned int *words,
+	const unsigned int *block_counts,
+	size_t              block_max,
+	unsigned int       *state
+)
+{
+	const LIBHONOKA_MD5_VEC ones = LIBHONOKA_MD5_SET1(0xFFFFFFFFU);
+	const LIBHONOKA_MD5_VEC counts = LIBHONOKA_MD5_LOAD(block_counts);
+	LIBHONOKA_MD5_VEC sa = LIBHONOKA_MD5_LOAD(state);
+	LIBHONOKA_MD5_VEC sb = LIBHONOKA_MD5_LOAD(state + LIBHONOKA_MD5_LANES);
+	LIBHONOKA_MD5_VEC sc = LIBHONOKA_MD5_LOAD(state + LIBHONOKA_MD5_LANES * 2);
+	LIBHONOKA_MD5_VEC sd = LIBHONOKA_MD5_LOAD(state + LIBHONOKA_MD5_LANES * 3);
+	size_t block;
+
+	for (block = 0; block < block_max; block++, words += 16 * LIBHONOKA_MD5_LANES)
+	{
+		LIBHONOKA_MD5_VEC x[16];
+		LIBHONOKA_MD5_VEC a = sa, b = sb, c = sc, d = sd, mask;
+		int i;
+
+		for (i = 0; i < 16; i++)
+			x[i] = LIBHONOKA_MD5_LOAD(words + i * LIBHONOKA_MD5_LANES);
+
+		/* Round 1 */
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, a, b, c, d, x[ 0], 0xD76AA478U,  7)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, d, a, b, c, x[ 1], 0xE8C7B756U, 12)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, c, d, a, b, x[ 2], 0x242070DBU, 17)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, b, c, d, a, x[ 3], 0xC1BDCEEEU, 22)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, a, b, c, d, x[ 4], 0xF57C0FAFU,  7)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, d, a, b, c, x[ 5], 0x4787C62AU, 12)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, c, d, a, b, x[ 6], 0xA8304613U, 17)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, b, c, d, a, x[ 7], 0xFD469501U, 22)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, a, b, c, d, x[ 8], 0x698098D8U,  7)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, d, a, b, c, x[ 9], 0x8B44F7AFU, 12)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, c, d, a, b, x[10], 0xFFFF5BB1U, 17)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, b, c, d, a, x[11], 0x895CD7BEU, 22)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, a, b, c, d, x[12], 0x6B901122U,  7)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, d, a, b, c, x[13], 0xFD987193U, 12)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, c, d, a, b, x[14], 0xA679438EU, 17)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_F, b, c, d, a, x[15], 0x49B40821U, 22)
+
+		/* Round 2 */
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, a, b, c, d, x[ 1], 0xF61E2562U,  5)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, d, a, b, c, x[ 6], 0xC040B340U,  9)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, c, d, a, b, x[11], 0x265E5A51U, 14)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, b, c, d, a, x[ 0], 0xE9B6C7AAU, 20)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, a, b, c, d, x[ 5], 0xD62F105DU,  5)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, d, a, b, c, x[10], 0x02441453U,  9)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, c, d, a, b, x[15], 0xD8A1E681U, 14)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, b, c, d, a, x[ 4], 0xE7D3FBC8U, 20)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, a, b, c, d, x[ 9], 0x21E1CDE6U,  5)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, d, a, b, c, x[14], 0xC33707D6U,  9)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, c, d, a, b, x[ 3], 0xF4D50D87U, 14)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, b, c, d, a, x[ 8], 0x455A14EDU, 20)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, a, b, c, d, x[13], 0xA9E3E905U,  5)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, d, a, b, c, x[ 2], 0xFCEFA3F8U,  9)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, c, d, a, b, x[ 7], 0x676F02D9U, 14)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_G, b, c, d, a, x[12], 0x8D2A4C8AU, 20)
+
+		/* Round 3 */
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, a, b, c, d, x[ 5], 0xFFFA3942U,  4)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, d, a, b, c, x[ 8], 0x8771F681U, 11)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, c, d, a, b, x[11], 0x6D9D6122U, 16)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, b, c, d, a, x[14], 0xFDE5380CU, 23)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, a, b, c, d, x[ 1], 0xA4BEEA44U,  4)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, d, a, b, c, x[ 4], 0x4BDECFA9U, 11)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, c, d, a, b, x[ 7], 0xF6BB4B60U, 16)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, b, c, d, a, x[10], 0xBEBFBC70U, 23)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, a, b, c, d, x[13], 0x289B7EC6U,  4)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, d, a, b, c, x[ 0], 0xEAA127FAU, 11)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, c, d, a, b, x[ 3], 0xD4EF3085U, 16)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, b, c, d, a, x[ 6], 0x04881D05U, 23)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, a, b, c, d, x[ 9], 0xD9D4D039U,  4)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, d, a, b, c, x[12], 0xE6DB99E5U, 11)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, c, d, a, b, x[15], 0x1FA27CF8U, 16)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_H, b, c, d, a, x[ 2], 0xC4AC5665U, 23)
+
+		/* Round 4 */
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, a, b, c, d, x[ 0], 0xF4292244U,  6)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, d, a, b, c, x[ 7], 0x432AFF97U, 10)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, c, d, a, b, x[14], 0xAB9423A7U, 15)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, b, c, d, a, x[ 5], 0xFC93A039U, 21)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, a, b, c, d, x[12], 0x655B59C3U,  6)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, d, a, b, c, x[ 3], 0x8F0CCC92U, 10)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, c, d, a, b, x[10], 0xFFEFF47DU, 15)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, b, c, d, a, x[ 1], 0x85845DD1U, 21)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, a, b, c, d, x[ 8], 0x6FA87E4FU,  6)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, d, a, b, c, x[15], 0xFE2CE6E0U, 10)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, c, d, a, b, x[ 6], 0xA3014314U, 15)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, b, c, d, a, x[13], 0x4E0811A1U, 21)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, a, b, c, d, x[ 4], 0xF7537E82U,  6)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, d, a, b, c, x[11], 0xBD3AF235U, 10)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, c, d, a, b, x[ 2], 0x2AD7D2BBU, 15)
+		LIBHONOKA_MD5_STEP(LIBHONOKA_MD5_I, b, c, d, a, x[ 9], 0xEB86D391U, 21)
+
+		/* Lanes whose message is shorter keep their state */
+		mask = LIBHONOKA_MD5_LESS(LIBHONOKA_MD5_SET1((unsigned int) block), counts);
+		sa = LIBHONOKA_MD5_ADD(sa, LIBHONOKA_MD5_AND(a, mask));
+		sb = LIBHONOKA_MD5_ADD(sb, LIBHONOKA_MD5_AND(b, mask));
+		sc = LIBHONOKA_MD5_ADD(sc, LIBHONOKA_MD5_AND(c, mask));
+		sd = LIBHONOKA_MD5_ADD(sd, LIBHONOKA_MD5_AND(d, mask));
+	}
+
+	LIBHONOKA_MD5_STORE(state, sa);
+	LIBHONOKA_MD5_STORE(state + LIBHONOKA_MD5_LANES, sb);
+	LIBHONOKA_MD5_STORE(state + LIBHONOKA_MD5_LANES * 2, sc);
+	LIBHONOKA_MD5_STORE(state + LIBHONOKA_MD5_LANES * 3, sd);
+}
+
+#undef LIBHONOKA_MD5_F
+#undef LIBHONOKA_MD5_G
+#undef LIBHONOKA_MD5_H
+#undef LIBHONOKA_MD5_I
+#undef LIBHONOKA_MD5_STEP
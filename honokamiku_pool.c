@@ -0,0 +1,409 @@
+/*!
+ * \file honokamiku_pool.c
+ * Worker thread pool and parallel block decryption
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define HONOKAMIKU_DECRYPTER_CORE
+
+#include "honokamiku_decrypter.h"
+#include "honokamiku_internal.h"
+#include "honokamiku_config.h"
+
+#ifndef HONOKAMIKU_NO_THREADS
+#	if defined(_WIN32) || defined(WIN32)
+#		define WIN32_LEAN_AND_MEAN
+#		include <windows.h>
+#		define LIBHONOKA_WIN32_THREADS
+typedef CRITICAL_SECTION libhonoka__mutex;
+typedef CONDITION_VARIABLE libhonoka__cond;
+typedef HANDLE libhonoka__thread;
+#		define libhonoka__mutex_init(m) InitializeCriticalSection(m)
+#		define libhonoka__mutex_free(m) DeleteCriticalSection(m)
+#		define libhonoka__mutex_lock(m) EnterCriticalSection(m)
+#		define libhonoka__mutex_unlock(m) LeaveCriticalSection(m)
+#		define libhonoka__cond_init(c) InitializeConditionVariable(c)
+#		define libhonoka__cond_free(c)
+#		define libhonoka__cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#		define libhonoka__cond_signal(c) WakeConditionVariable(c)
+#		define libhonoka__cond_broadcast(c) WakeAllConditionVariable(c)
+#	else
+#		include <pthread.h>
+#		include <unistd.h>
+typedef pthread_mutex_t libhonoka__mutex;
+typedef pthread_cond_t libhonoka__cond;
+typedef pthread_t libhonoka__thread;
+#		define libhonoka__mutex_init(m) pthread_mutex_init(m, NULL)
+#		define libhonoka__mutex_free(m) pthread_mutex_destroy(m)
+#		define libhonoka__mutex_lock(m) pthread_mutex_lock(m)
+#		define libhonoka__mutex_unlock(m) pthread_mutex_unlock(m)
+#		define libhonoka__cond_init(c) pthread_cond_init(c, NULL)
+#		define libhonoka__cond_free(c) pthread_cond_destroy(c)
+#		define libhonoka__cond_wait(c, m) pthread_cond_wait(c, m)
+#		define libhonoka__cond_signal(c) pthread_cond_signal(c)
+#		define libhonoka__cond_broadcast(c) pthread_cond_broadcast(c)
+#	endif
+#endif
+
+/*!
+ * Default minimum chunk size per thread. Smaller chunks are not worth waking
+ * up the workers for.
+ */
+#define LIBHONOKA_POOL_MIN_CHUNK 262144
+
+struct honokamiku_pool
+{
+	size_t               thread_count; /* Including the calling thread */
+	size_t               min_chunk;    /* Minimum bytes per thread */
+#ifndef HONOKAMIKU_NO_THREADS
+	libhonoka__mutex     run_lock;     /* Serialize libhonoka__pool_run */
+	libhonoka__mutex     lock;         /* Protects everything below */
+	libhonoka__cond      work_cond;    /* Signaled when tasks are queued */
+	libhonoka__cond      done_cond;    /* Signaled when tasks are done */
+	libhonoka__pool_task task;
+	void                *task_arg;
+	size_t               task_count;
+	size_t               task_next;    /* Next task index to run */
+	size_t               task_pending; /* Tasks not yet finished */
+	int                  quit;
+	libhonoka__thread   *threads;
+	size_t               thread_started;
+#endif
+};
+
+#ifndef HONOKAMIKU_NO_THREADS
+/* Take tasks until told to quit. Called with the lock held. */
+static void libhonoka__pool_work(honokamiku_pool *pool, int wait)
+{
+	for(;;)
+	{
+		libhonoka__pool_task task;
+		void *arg;
+		size_t index;
+
+		if (pool->task_next >= pool->task_count)
+		{
+			if (!wait || pool->quit) return;
+
+			libhonoka__cond_wait(&pool->work_cond, &pool->lock);
+			continue;
+		}
+
+		task = pool->task;
+		arg = pool->task_arg;
+		index = pool->task_next++;
+
+		libhonoka__mutex_unlock(&pool->lock);
+		task(arg, index);
+		libhonoka__mutex_lock(&pool->lock);
+
+		if (--pool->task_pending == 0)
+			libhonoka__cond_signal(&pool->done_cond);
+	}
+}
+
+#ifdef LIBHONOKA_WIN32_THREADS
+static DWORD WINAPI libhonoka__pool_thread(LPVOID param)
+#else
+static void *libhonoka__pool_thread(void *param)
+#endif
+{
+	honokamiku_pool *pool = (honokamiku_pool *) param;
+
+	libhonoka__mutex_lock(&pool->lock);
+	libhonoka__pool_work(pool, 1);
+	libhonoka__mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+static size_t libhonoka__cpu_count()
+{
+#ifdef LIBHONOKA_WIN32_THREADS
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return count > 0 ? (size_t) count : 1;
+#else
+	return 1;
+#endif
+}
+#endif /* HONOKAMIKU_NO_THREADS */
+
+honokamiku_pool *honokamiku_pool_create(size_t thread_count)
+{
+	honokamiku_pool *pool;
+
+	pool = (honokamiku_pool *) calloc(1, sizeof(honokamiku_pool));
+	if (pool == NULL) return NULL;
+
+	pool->min_chunk = LIBHONOKA_POOL_MIN_CHUNK;
+
+#ifdef HONOKAMIKU_NO_THREADS
+	pool->thread_count = 1;
+#else
+	if (thread_count == 0) thread_count = libhonoka__cpu_count();
+
+	libhonoka__mutex_init(&pool->run_lock);
+	libhonoka__mutex_init(&pool->lock);
+	libhonoka__cond_init(&pool->work_cond);
+	libhonoka__cond_init(&pool->done_cond);
+
+	/* The calling thread is one of the workers */
+	if (thread_count > 1)
+	{
+		pool->threads = (libhonoka__thread *) malloc(
+			(thread_count - 1) * sizeof(libhonoka__thread)
+		);
+
+		if (pool->threads == NULL)
+			thread_count = 1;
+	}
+
+	for (; pool->thread_started < thread_count - 1; pool->thread_started++)
+	{
+		libhonoka__thread *thread = &pool->threads[pool->thread_started];
+
+#ifdef LIBHONOKA_WIN32_THREADS
+		*thread = CreateThread(NULL, 0, libhonoka__pool_thread, pool, 0, NULL);
+		if (*thread == NULL) break;
+#else
+		if (pthread_create(thread, NULL, libhonoka__pool_thread, pool) != 0)
+			break;
+#endif
+	}
+
+	/* Make do with the threads which could be started */
+	pool->thread_count = pool->thread_started + 1;
+#endif
+
+	return pool;
+}
+
+void honokamiku_pool_free(honokamiku_pool *pool)
+{
+#ifndef HONOKAMIKU_NO_THREADS
+	size_t i;
+#endif
+
+	if (pool == NULL) return;
+
+#ifndef HONOKAMIKU_NO_THREADS
+	libhonoka__mutex_lock(&pool->lock);
+	pool->quit = 1;
+	libhonoka__cond_broadcast(&pool->work_cond);
+	libhonoka__mutex_unlock(&pool->lock);
+
+	for (i = 0; i < pool->thread_started; i++)
+	{
+#ifdef LIBHONOKA_WIN32_THREADS
+		WaitForSingleObject(pool->threads[i], INFINITE);
+		CloseHandle(pool->threads[i]);
+#else
+		pthread_join(pool->threads[i], NULL);
+#endif
+	}
+
+	libhonoka__cond_free(&pool->done_cond);
+	libhonoka__cond_free(&pool->work_cond);
+	libhonoka__mutex_free(&pool->lock);
+	libhonoka__mutex_free(&pool->run_lock);
+	free(pool->threads);
+#endif
+
+	free(pool);
+}
+
+size_t honokamiku_pool_thread_count(const honokamiku_pool *pool)
+{
+	return pool->thread_count;
+}
+
+void libhonoka__pool_run(
+	honokamiku_pool     *pool,
+	libhonoka__pool_task task,
+	void                *arg,
+	size_t               count
+)
+{
+#ifdef HONOKAMIKU_NO_THREADS
+	size_t i;
+
+	for (i = 0; i < count; i++)
+		task(arg, i);
+#else
+	if (count == 0) return;
+
+	libhonoka__mutex_lock(&pool->run_lock);
+	libhonoka__mutex_lock(&pool->lock);
+
+	pool->task = task;
+	pool->task_arg = arg;
+	pool->task_count = count;
+	pool->task_next = 0;
+	pool->task_pending = count;
+
+	if (count > 1)
+		libhonoka__cond_broadcast(&pool->work_cond);
+
+	/* Help, then wait for the tasks taken by the workers */
+	libhonoka__pool_work(pool, 0);
+	while (pool->task_pending > 0)
+		libhonoka__cond_wait(&pool->done_cond, &pool->lock);
+
+	pool->task_count = pool->task_next = 0;
+
+	libhonoka__mutex_unlock(&pool->lock);
+	libhonoka__mutex_unlock(&pool->run_lock);
+#endif
+}
+
+/*!
+ * Parallel decryption state. Chunk `i` starts at `i * chunk_size`, the last
+ * chunk takes the remainder.
+ */
+typedef struct libhonoka__chunks
+{
+	honokamiku_context *contexts;
+	unsigned char      *buffer;
+	size_t              size;
+	size_t              chunk_size;
+	size_t              count;
+	unsigned char      *prev;  /* Version 5: Encrypted byte before chunk */
+	unsigned char      *carry; /* Version 5 encryption: Fixup of chunk */
+} libhonoka__chunks;
+
+static size_t libhonoka__chunk_length(const libhonoka__chunks *chunks, size_t i)
+{
+	return i == chunks->count - 1 ? chunks->size - i * chunks->chunk_size : chunks->chunk_size;
+}
+
+/*!
+ * Seek chunk context to the chunk and decrypt it. Version 5 encryption
+ * chunks are encrypted as if the byte before them were encrypted to 0.
+ * Version 5 encryption is a prefix-XOR, so the real bytes only differ by
+ * the real previous encrypted byte, which is XOR-ed later.
+ */
+static void libhonoka__decrypt_chunk(void *arg, size_t i)
+{
+	libhonoka__chunks *chunks = (libhonoka__chunks *) arg;
+	honokamiku_context *dctx = &chunks->contexts[i];
+	size_t start = i * chunks->chunk_size;
+
+	if (i > 0)
+		honokamiku_jump_offset_v5(dctx, dctx->pos + (unsigned int) start, chunks->prev[i]);
+
+	honokamiku_decrypt_block(dctx, chunks->buffer + start, libhonoka__chunk_length(chunks, i));
+}
+
+static void libhonoka__v5_fixup_chunk(void *arg, size_t i)
+{
+	libhonoka__chunks *chunks = (libhonoka__chunks *) arg;
+	unsigned char *buffer = chunks->buffer + i * chunks->chunk_size;
+	unsigned char carry = chunks->carry[i];
+	size_t length = libhonoka__chunk_length(chunks, i);
+	size_t j;
+
+	if (carry == 0) return;
+
+	for (j = 0; j < length; j++)
+		buffer[j] ^= carry;
+}
+
+static int libhonoka__decrypt_parallel(
+	honokamiku_pool    *pool,
+	honokamiku_context *dctx,
+	unsigned char      *buffer,
+	size_t              size,
+	size_t              count
+)
+{
+	libhonoka__chunks chunks;
+	int v5_encrypt = dctx->dm == honokamiku_decrypt_version5 && dctx->v5_encrypt;
+	size_t i;
+
+	chunks.contexts = (honokamiku_context *) malloc(
+		count * (sizeof(honokamiku_context) + 2)
+	);
+	if (chunks.contexts == NULL) return 0;
+
+	chunks.prev = (unsigned char *) &chunks.contexts[count];
+	chunks.carry = chunks.prev + count;
+	chunks.buffer = buffer;
+	chunks.size = size;
+	/* Keep chunks aligned to cache line and whole keys */
+	chunks.chunk_size = (size / count) & ~((size_t) 63);
+	chunks.count = count;
+
+	for (i = 0; i < count; i++)
+	{
+		chunks.contexts[i] = *dctx;
+		/* Version 5 decryption chains the encrypted bytes, so take them */
+		/* before they're decrypted in-place */
+		chunks.prev[i] = i > 0 && !v5_encrypt ? buffer[i * chunks.chunk_size - 1] : 0;
+	}
+
+	libhonoka__pool_run(pool, libhonoka__decrypt_chunk, &chunks, count);
+
+	if (v5_encrypt)
+	{
+		/* The real byte before chunk `i` is its last local byte ^ its carry */
+		chunks.carry[0] = 0;
+		for (i = 1; i < count; i++)
+			chunks.carry[i] = chunks.carry[i - 1] ^ buffer[i * chunks.chunk_size - 1];
+
+		libhonoka__pool_run(pool, libhonoka__v5_fixup_chunk, &chunks, count);
+	}
+
+	*dctx = chunks.contexts[count - 1];
+	if (v5_encrypt)
+		dctx->v5_chain = buffer[size - 1];
+
+	free(chunks.contexts);
+	return 1;
+}
+
+void honokamiku_pool_set_min_chunk(honokamiku_pool *pool, size_t min_chunk)
+{
+	if (min_chunk == 0)
+		min_chunk = LIBHONOKA_POOL_MIN_CHUNK;
+	else if (min_chunk < 64)
+		/* Chunks are multiple of 64 bytes */
+		min_chunk = 64;
+
+	pool->min_chunk = min_chunk;
+}
+
+void honokamiku_decrypt_block_parallel(
+	honokamiku_pool    *pool,
+	honokamiku_context *dctx,
+	void               *buffer,
+	size_t              buffer_size
+)
+{
+	size_t count;
+
+	if (
+		pool == NULL ||
+		dctx->dm <= honokamiku_decrypt_none ||
+		dctx->dm > honokamiku_decrypt_version6 ||
+		(dctx->dm >= honokamiku_decrypt_version3 && !dctx->v3_initialized)
+	)
+	{
+		honokamiku_decrypt_block(dctx, buffer, buffer_size);
+		return;
+	}
+
+	count = buffer_size / pool->min_chunk;
+	if (count > pool->thread_count) count = pool->thread_count;
+
+	if (count < 2 ||
+	    !libhonoka__decrypt_parallel(pool, dctx, (unsigned char *) buffer, buffer_size, count))
+		honokamiku_decrypt_block(dctx, buffer, buffer_size);
+}
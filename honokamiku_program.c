@@ -361,8 +361,9 @@ int main(int argc, char *argv[])
 				case 'v':
 				{
 					printf("HonokaMiku in ANSI C with libhonoka %s (%d)\n"
-						 "Copyright (c) 2044 Dark Energy Processor Corporation\nLicensed under terms of MIT license.\n",
-						 honokamiku_version_string(), (int)(honokamiku_version()));
+						 "Copyright (c) 2044 Dark Energy Processor Corporation\nLicensed under terms of MIT license.\n"
+						 "Kernels: %s\n",
+						 honokamiku_version_string(), (int)(honokamiku_version()), honokamiku_kernel_name());
 					return 0;
 				}
 				default:
@@ -571,8 +572,7 @@ int main(int argc, char *argv[])
 				free_size = file_contents_size - file_contents_length;
 			}
 
-			honokamiku_decrypt_block(dctx, byte_buffer, read_bytes);
-			memcpy(file_buffer + file_contents_length, byte_buffer, read_bytes);
+			honokamiku_decrypt_copy(dctx, byte_buffer, file_buffer + file_contents_length, read_bytes);
 			file_contents_length += read_bytes;
 		}
 
@@ -34,8 +34,16 @@
 /* -- include the following line if the md5.h header file is separate -- */
 #include "md5.h"
 
-/* forward declaration */
-static void Transform ();
+#include <string.h>
+
+/* Transform is small enough to be inlined into MD5Update */
+#if defined(_MSC_VER)
+#define MD5_INLINE __inline
+#elif defined(__GNUC__)
+#define MD5_INLINE __inline__
+#else
+#define MD5_INLINE
+#endif
 
 static unsigned char MD5_PADDING[64] = {
   0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -49,14 +57,20 @@ static unsigned char MD5_PADDING[64] = {
 };
 
 /* F, G and H are basic MD5 functions: selection, majority, parity */
-#define MD5_F(x, y, z) (((x) & (y)) | ((~x) & (z)))
-#define MD5_G(x, y, z) (((x) & (z)) | ((y) & (~z)))
+/* F and G are written as multiplexers, which take one operation less */
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
 #define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
 #define MD5_I(x, y, z) ((y) ^ ((x) | (~z))) 
 
 /* ROTATE_LEFT rotates x left n bits */
 #define ROTATE_LEFT(x, n) (((x) << (n)) | ((x) >> (32-(n))))
 
+/* MD5_LOAD reads little-endian word at p + n, whatever the alignment */
+#define MD5_LOAD(p, n) \
+  (((UINT4)(p)[(n)]) | (((UINT4)(p)[(n)+1]) << 8) | \
+   (((UINT4)(p)[(n)+2]) << 16) | (((UINT4)(p)[(n)+3]) << 24))
+
 /* MD5_FF, MD5_GG, MD5_HH, and MD5_II transformations for rounds 1, 2, 3, and 4 */
 /* Rotation is separate from addition to prevent recomputation */
 #define MD5_FF(a, b, c, d, x, s, ac) \
@@ -80,95 +94,30 @@ static unsigned char MD5_PADDING[64] = {
    (a) += (b); \
   }
 
-void MD5Init(MD5_CTX *mdContext)
-{
-  mdContext->i[0] = mdContext->i[1] = (UINT4)0;
-
-  /* Load magic initialization constants.
-   */
-  mdContext->buf[0] = (UINT4)0x67452301;
-  mdContext->buf[1] = (UINT4)0xefcdab89;
-  mdContext->buf[2] = (UINT4)0x98badcfe;
-  mdContext->buf[3] = (UINT4)0x10325476;
-}
-
-void MD5Update (MD5_CTX *mdContext, unsigned const char *inBuf, unsigned int inLen)
-{
-  UINT4 in[16];
-  int mdi;
-  unsigned int i, ii;
-
-  /* compute number of bytes mod 64 */
-  mdi = (int)((mdContext->i[0] >> 3) & 0x3F);
-
-  /* update number of bits */
-  if ((mdContext->i[0] + ((UINT4)inLen << 3)) < mdContext->i[0])
-    mdContext->i[1]++;
-  mdContext->i[0] += ((UINT4)inLen << 3);
-  mdContext->i[1] += ((UINT4)inLen >> 29);
-
-  while (inLen--) {
-    /* add new character to buffer, increment mdi */
-    mdContext->in[mdi++] = *inBuf++;
-
-    /* transform if necessary */
-    if (mdi == 0x40) {
-      for (i = 0, ii = 0; i < 16; i++, ii += 4)
-        in[i] = (((UINT4)mdContext->in[ii+3]) << 24) |
-                (((UINT4)mdContext->in[ii+2]) << 16) |
-                (((UINT4)mdContext->in[ii+1]) << 8) |
-                ((UINT4)mdContext->in[ii]);
-      Transform (mdContext->buf, in);
-      mdi = 0;
-    }
-  }
-}
-
-void MD5Final(MD5_CTX *mdContext)
-{
-  UINT4 in[16];
-  int mdi;
-  unsigned int i, ii;
-  unsigned int padLen;
-
-  /* save number of bits */
-  in[14] = mdContext->i[0];
-  in[15] = mdContext->i[1];
-
-  /* compute number of bytes mod 64 */
-  mdi = (int)((mdContext->i[0] >> 3) & 0x3F);
-
-  /* pad out to 56 mod 64 */
-  padLen = (mdi < 56) ? (56 - mdi) : (120 - mdi);
-  MD5Update (mdContext, MD5_PADDING, padLen);
-
-  /* append length in bits and transform */
-  for (i = 0, ii = 0; i < 14; i++, ii += 4)
-    in[i] = (((UINT4)mdContext->in[ii+3]) << 24) |
-            (((UINT4)mdContext->in[ii+2]) << 16) |
-            (((UINT4)mdContext->in[ii+1]) << 8) |
-            ((UINT4)mdContext->in[ii]);
-  Transform (mdContext->buf, in);
-
-  /* store buffer in digest */
-  for (i = 0, ii = 0; i < 4; i++, ii += 4) {
-    mdContext->digest[ii] = (unsigned char)(mdContext->buf[i] & 0xFF);
-    mdContext->digest[ii+1] =
-      (unsigned char)((mdContext->buf[i] >> 8) & 0xFF);
-    mdContext->digest[ii+2] =
-      (unsigned char)((mdContext->buf[i] >> 16) & 0xFF);
-    mdContext->digest[ii+3] =
-      (unsigned char)((mdContext->buf[i] >> 24) & 0xFF);
-  }
-}
-
-/* Basic MD5 step. Transform buf based on in.
+/* Basic MD5 step. Transform buf based on one 64-byte block, read
+   directly from the caller's memory.
  */
-static void Transform (buf, in)
-UINT4 *buf;
-UINT4 *in;
+static MD5_INLINE void Transform (UINT4 *buf, const unsigned char *block)
 {
   UINT4 a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+  UINT4 in[16];
+
+  in[ 0] = MD5_LOAD (block,  0);
+  in[ 1] = MD5_LOAD (block,  4);
+  in[ 2] = MD5_LOAD (block,  8);
+  in[ 3] = MD5_LOAD (block, 12);
+  in[ 4] = MD5_LOAD (block, 16);
+  in[ 5] = MD5_LOAD (block, 20);
+  in[ 6] = MD5_LOAD (block, 24);
+  in[ 7] = MD5_LOAD (block, 28);
+  in[ 8] = MD5_LOAD (block, 32);
+  in[ 9] = MD5_LOAD (block, 36);
+  in[10] = MD5_LOAD (block, 40);
+  in[11] = MD5_LOAD (block, 44);
+  in[12] = MD5_LOAD (block, 48);
+  in[13] = MD5_LOAD (block, 52);
+  in[14] = MD5_LOAD (block, 56);
+  in[15] = MD5_LOAD (block, 60);
 
   /* Round 1 */
 #define S11 7
@@ -264,6 +213,89 @@ UINT4 *in;
   buf[3] += d;
 }
 
+void MD5Init(MD5_CTX *mdContext)
+{
+  mdContext->i[0] = mdContext->i[1] = (UINT4)0;
+
+  /* Load magic initialization constants.
+   */
+  mdContext->buf[0] = (UINT4)0x67452301;
+  mdContext->buf[1] = (UINT4)0xefcdab89;
+  mdContext->buf[2] = (UINT4)0x98badcfe;
+  mdContext->buf[3] = (UINT4)0x10325476;
+}
+
+void MD5Update (MD5_CTX *mdContext, unsigned const char *inBuf, unsigned int inLen)
+{
+  unsigned int mdi, fill;
+
+  /* compute number of bytes mod 64 */
+  mdi = (unsigned int)((mdContext->i[0] >> 3) & 0x3F);
+
+  /* update number of bits */
+  if ((mdContext->i[0] + ((UINT4)inLen << 3)) < mdContext->i[0])
+    mdContext->i[1]++;
+  mdContext->i[0] += ((UINT4)inLen << 3);
+  mdContext->i[1] += ((UINT4)inLen >> 29);
+
+  /* complete the buffered block first */
+  if (mdi) {
+    fill = 64 - mdi;
+    if (inLen < fill) {
+      memcpy (mdContext->in + mdi, inBuf, inLen);
+      return;
+    }
+    memcpy (mdContext->in + mdi, inBuf, fill);
+    Transform (mdContext->buf, mdContext->in);
+    inBuf += fill;
+    inLen -= fill;
+  }
+
+  /* whole blocks are transformed in place */
+  for (; inLen >= 64; inBuf += 64, inLen -= 64)
+    Transform (mdContext->buf, inBuf);
+
+  /* buffer the tail */
+  memcpy (mdContext->in, inBuf, inLen);
+}
+
+void MD5Final(MD5_CTX *mdContext)
+{
+  UINT4 bits[2];
+  unsigned int mdi;
+  unsigned int i, ii;
+  unsigned int padLen;
+
+  /* save number of bits */
+  bits[0] = mdContext->i[0];
+  bits[1] = mdContext->i[1];
+
+  /* compute number of bytes mod 64 */
+  mdi = (unsigned int)((mdContext->i[0] >> 3) & 0x3F);
+
+  /* pad out to 56 mod 64 */
+  padLen = (mdi < 56) ? (56 - mdi) : (120 - mdi);
+  MD5Update (mdContext, MD5_PADDING, padLen);
+
+  /* append length in bits and transform */
+  for (i = 0; i < 4; i++) {
+    mdContext->in[56+i] = (unsigned char)(bits[0] >> (i * 8));
+    mdContext->in[60+i] = (unsigned char)(bits[1] >> (i * 8));
+  }
+  Transform (mdContext->buf, mdContext->in);
+
+  /* store buffer in digest */
+  for (i = 0, ii = 0; i < 4; i++, ii += 4) {
+    mdContext->digest[ii] = (unsigned char)(mdContext->buf[i] & 0xFF);
+    mdContext->digest[ii+1] =
+      (unsigned char)((mdContext->buf[i] >> 8) & 0xFF);
+    mdContext->digest[ii+2] =
+      (unsigned char)((mdContext->buf[i] >> 16) & 0xFF);
+    mdContext->digest[ii+3] =
+      (unsigned char)((mdContext->buf[i] >> 24) & 0xFF);
+  }
+}
+
 /*
  **********************************************************************
  ** End of md5.c                                                     **